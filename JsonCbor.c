@@ -0,0 +1,615 @@
+﻿#include "JsonCbor.h"
+
+#include <ctype.h>
+#include <limits.h>
+#include <string.h>
+
+typedef struct _JsonCborTranscoder
+{
+	JsonParser scanner_;
+	JsonBuffer* out_;
+	int depth_;
+	long long textLen_; /* length of minified json, which JsonCbor_parse renders */
+} JsonCborTranscoder;
+
+typedef struct _JsonCborReader
+{
+	JsonParser* parser_;
+	const unsigned char* str_;
+	const unsigned char* end_;
+	char* out_;          /* next byte of rendered text */
+	const char* outEnd_; /* end of text, reserved once for text length from document header */
+} JsonCborReader;
+
+enum
+{
+	JsonCbor_unsigned = 0,
+	JsonCbor_negative = 1,
+	JsonCbor_text = 3,
+	JsonCbor_array = 4,
+	JsonCbor_map = 5,
+	JsonCbor_tag = 6,
+	JsonCbor_simple = 7
+};
+
+enum
+{
+	JsonCbor_false = 0xF4,
+	JsonCbor_true = 0xF5,
+	JsonCbor_null = 0xF6
+};
+
+static void JsonCborTranscoder_parseValue(JsonCborTranscoder* transcoder);
+static void JsonCborReader_readValue(JsonCborReader* reader);
+
+static void JsonCborTranscoder_appendByte(JsonCborTranscoder* transcoder, unsigned char byte)
+{
+	if (!JsonBuffer_reserve(transcoder->out_, 1))
+	{
+		transcoder->scanner_.isInvalid = 1;
+		return;
+	}
+	transcoder->out_->data[transcoder->out_->len++] = (char)byte;
+}
+
+static void JsonCborTranscoder_appendHead(JsonCborTranscoder* transcoder, int major, unsigned long long value)
+{
+	unsigned char head[9];
+	int len;
+	if (value < 24)
+	{
+		head[0] = (unsigned char)(major << 5 | value);
+		len = 1;
+	}
+	else
+	{
+		int bytes = value <= 0xFF ? 1 : value <= 0xFFFF ? 2 : value <= 0xFFFFFFFF ? 4 : 8;
+		head[0] = (unsigned char)(major << 5 | (bytes == 1 ? 24 : bytes == 2 ? 25 : bytes == 4 ? 26 : 27));
+		for (int i = bytes; i > 0; --i)
+		{
+			head[i] = (unsigned char)value;
+			value >>= 8;
+		}
+		len = bytes + 1;
+	}
+	if (!JsonBuffer_append(transcoder->out_, (const char*)head, len))
+	{
+		transcoder->scanner_.isInvalid = 1;
+	}
+}
+
+static void JsonCborTranscoder_appendText(JsonCborTranscoder* transcoder, const char* begin, int len)
+{
+	JsonCborTranscoder_appendHead(transcoder, JsonCbor_text, len);
+	if (!JsonBuffer_append(transcoder->out_, begin, len))
+	{
+		transcoder->scanner_.isInvalid = 1;
+	}
+}
+
+/* Writes head with 4 byte value to be patched by JsonCborTranscoder_patchHead, e.g. container length. Returns its offset. */
+static int JsonCborTranscoder_beginHead(JsonCborTranscoder* transcoder, int major)
+{
+	int offset = transcoder->out_->len;
+	JsonCborTranscoder_appendHead(transcoder, major, 0xFFFFFFFF);
+	return offset;
+}
+
+static void JsonCborTranscoder_patchHead(JsonCborTranscoder* transcoder, int offset, unsigned int value)
+{
+	if (transcoder->scanner_.isInvalid)
+	{
+		return;
+	}
+	unsigned char* head = (unsigned char*)transcoder->out_->data + offset;
+	head[1] = (unsigned char)(value >> 24);
+	head[2] = (unsigned char)(value >> 16);
+	head[3] = (unsigned char)(value >> 8);
+	head[4] = (unsigned char)value;
+}
+
+/* Closes container of count items. Its text has brackets and count - 1 commas. */
+static void JsonCborTranscoder_endContainer(JsonCborTranscoder* transcoder, int head, unsigned int count)
+{
+	JsonCborTranscoder_patchHead(transcoder, head, count);
+	transcoder->textLen_ += count ? count + 1 : 2;
+	--transcoder->depth_;
+}
+
+static int JsonCborTranscoder_consume(JsonCborTranscoder* transcoder, char c)
+{
+	JsonParser_consumeWhiteSpaces(&transcoder->scanner_);
+	if (transcoder->scanner_.str_ == transcoder->scanner_.end_ || *transcoder->scanner_.str_ != c)
+	{
+		return 0;
+	}
+	++transcoder->scanner_.str_;
+	return 1;
+}
+
+static int JsonCborTranscoder_enter(JsonCborTranscoder* transcoder)
+{
+	if (++transcoder->depth_ > MAX_DEPTH)
+	{
+		transcoder->scanner_.isInvalid = 1;
+		return 0;
+	}
+	return 1;
+}
+
+static void JsonCborTranscoder_parseArray(JsonCborTranscoder* transcoder)
+{
+	if (!JsonCborTranscoder_enter(transcoder))
+	{
+		return;
+	}
+	int head = JsonCborTranscoder_beginHead(transcoder, JsonCbor_array);
+	unsigned int count = 0;
+	JsonCborTranscoder_consume(transcoder, '[');
+	if (JsonCborTranscoder_consume(transcoder, ']'))
+	{
+		JsonCborTranscoder_endContainer(transcoder, head, count);
+		return;
+	}
+
+	while (!transcoder->scanner_.isInvalid)
+	{
+		JsonCborTranscoder_parseValue(transcoder);
+		++count;
+		if (JsonCborTranscoder_consume(transcoder, ','))
+		{
+			continue;
+		}
+		if (JsonCborTranscoder_consume(transcoder, ']'))
+		{
+			JsonCborTranscoder_endContainer(transcoder, head, count);
+			return;
+		}
+		transcoder->scanner_.isInvalid = 1;
+	}
+}
+
+static void JsonCborTranscoder_parseObject(JsonCborTranscoder* transcoder)
+{
+	if (!JsonCborTranscoder_enter(transcoder))
+	{
+		return;
+	}
+	int head = JsonCborTranscoder_beginHead(transcoder, JsonCbor_map);
+	unsigned int count = 0;
+	JsonCborTranscoder_consume(transcoder, '{');
+	if (JsonCborTranscoder_consume(transcoder, '}'))
+	{
+		JsonCborTranscoder_endContainer(transcoder, head, count);
+		return;
+	}
+
+	while (!transcoder->scanner_.isInvalid)
+	{
+		JsonParser_consumeWhiteSpaces(&transcoder->scanner_);
+		if (transcoder->scanner_.str_ == transcoder->scanner_.end_ || *transcoder->scanner_.str_ != '\"')
+		{
+			transcoder->scanner_.isInvalid = 1;
+			return;
+		}
+		const char* beginKey = transcoder->scanner_.str_ + 1;
+		JsonParser_parseString(&transcoder->scanner_);
+		const char* endKey = transcoder->scanner_.str_ - 1;
+		if (transcoder->scanner_.isInvalid)
+		{
+			return;
+		}
+		JsonCborTranscoder_appendText(transcoder, beginKey, (int)(endKey - beginKey));
+		transcoder->textLen_ += endKey - beginKey + 3;
+		if (!JsonCborTranscoder_consume(transcoder, ':'))
+		{
+			transcoder->scanner_.isInvalid = 1;
+			return;
+		}
+
+		JsonCborTranscoder_parseValue(transcoder);
+		++count;
+		if (JsonCborTranscoder_consume(transcoder, ','))
+		{
+			continue;
+		}
+		if (JsonCborTranscoder_consume(transcoder, '}'))
+		{
+			JsonCborTranscoder_endContainer(transcoder, head, count);
+			return;
+		}
+		transcoder->scanner_.isInvalid = 1;
+	}
+}
+
+static void JsonCborTranscoder_appendNumber(JsonCborTranscoder* transcoder, const char* begin, const char* end)
+{
+	const char* digits = *begin == '-' ? begin + 1 : begin;
+	int isInteger = end - digits <= 18 && (*digits != '0' || end - digits == 1);
+	unsigned long long magnitude = 0;
+	for (const char* it = digits; it < end && isInteger; ++it)
+	{
+		isInteger = isdigit(*it);
+		magnitude = magnitude * 10 + (*it - '0');
+	}
+
+	transcoder->textLen_ += end - begin;
+	if (!isInteger)
+	{
+		JsonCborTranscoder_appendHead(transcoder, JsonCbor_tag, JSON_CBOR_NUMBER_TAG);
+		JsonCborTranscoder_appendText(transcoder, begin, (int)(end - begin));
+		return;
+	}
+	if (*begin == '-')
+	{
+		JsonCborTranscoder_appendHead(transcoder, JsonCbor_negative, magnitude - 1);
+		return;
+	}
+	JsonCborTranscoder_appendHead(transcoder, JsonCbor_unsigned, magnitude);
+}
+
+static void JsonCborTranscoder_parseValue(JsonCborTranscoder* transcoder)
+{
+	JsonParser* scanner = &transcoder->scanner_;
+	JsonParser_consumeWhiteSpaces(scanner);
+	if (scanner->str_ == scanner->end_)
+	{
+		scanner->isInvalid = 1;
+		return;
+	}
+
+	const char* beginValue = scanner->str_;
+	if (*scanner->str_ == '\"')
+	{
+		JsonParser_parseString(scanner);
+		if (!scanner->isInvalid)
+		{
+			JsonCborTranscoder_appendText(transcoder, beginValue + 1, (int)(scanner->str_ - beginValue - 2));
+			transcoder->textLen_ += scanner->str_ - beginValue;
+		}
+		return;
+	}
+	if (isdigit(*scanner->str_) || *scanner->str_ == '-')
+	{
+		JsonParser_parseNumber(scanner);
+		if (!scanner->isInvalid)
+		{
+			JsonCborTranscoder_appendNumber(transcoder, beginValue, scanner->str_);
+		}
+		return;
+	}
+	if (*scanner->str_ == '{')
+	{
+		JsonCborTranscoder_parseObject(transcoder);
+		return;
+	}
+	if (*scanner->str_ == '[')
+	{
+		JsonCborTranscoder_parseArray(transcoder);
+		return;
+	}
+	if ((scanner->end_ - scanner->str_ >= 4) && (0 == strncmp(scanner->str_, "true", 4)))
+	{
+		scanner->str_ += 4;
+		transcoder->textLen_ += 4;
+		JsonCborTranscoder_appendByte(transcoder, JsonCbor_true);
+		return;
+	}
+	if ((scanner->end_ - scanner->str_ >= 4) && (0 == strncmp(scanner->str_, "null", 4)))
+	{
+		scanner->str_ += 4;
+		transcoder->textLen_ += 4;
+		JsonCborTranscoder_appendByte(transcoder, JsonCbor_null);
+		return;
+	}
+	if ((scanner->end_ - scanner->str_ >= 5) && (0 == strncmp(scanner->str_, "false", 5)))
+	{
+		scanner->str_ += 5;
+		transcoder->textLen_ += 5;
+		JsonCborTranscoder_appendByte(transcoder, JsonCbor_false);
+		return;
+	}
+	scanner->isInvalid = 1;
+}
+
+int JsonCbor_fromJson(JsonBuffer* out, const char* jsonBegin, const char* jsonEnd)
+{
+	JsonCborTranscoder transcoder;
+	transcoder.scanner_.str_ = jsonBegin;
+	transcoder.scanner_.end_ = jsonEnd;
+	transcoder.scanner_.inform_ = NULL;
+	transcoder.scanner_.uriParts_.nParts = 0;
+	transcoder.scanner_.isInvalid = 0;
+	transcoder.out_ = out;
+	transcoder.depth_ = 0;
+	transcoder.textLen_ = 0;
+
+	JsonCborTranscoder_appendHead(&transcoder, JsonCbor_tag, JSON_CBOR_DOCUMENT_TAG);
+	JsonCborTranscoder_appendHead(&transcoder, JsonCbor_array, 2);
+	int textLenHead = JsonCborTranscoder_beginHead(&transcoder, JsonCbor_unsigned);
+	JsonCborTranscoder_parseValue(&transcoder);
+	JsonParser_consumeWhiteSpaces(&transcoder.scanner_);
+	if (transcoder.textLen_ > INT_MAX)
+	{
+		transcoder.scanner_.isInvalid = 1;
+	}
+	JsonCborTranscoder_patchHead(&transcoder, textLenHead, (unsigned int)transcoder.textLen_);
+
+	return transcoder.scanner_.isInvalid
+		|| transcoder.scanner_.str_ != transcoder.scanner_.end_;
+}
+
+/* Returns position to render len bytes to, or NULL if they do not fit into the text length from document header. */
+static char* JsonCborReader_reserve(JsonCborReader* reader, unsigned long long len)
+{
+	if (len > (unsigned long long)(reader->outEnd_ - reader->out_))
+	{
+		reader->parser_->isInvalid = 1;
+		return NULL;
+	}
+	char* out = reader->out_;
+	reader->out_ += len;
+	return out;
+}
+
+static void JsonCborReader_append(JsonCborReader* reader, const char* begin, int len)
+{
+	char* out = JsonCborReader_reserve(reader, len);
+	if (out)
+	{
+		memcpy(out, begin, len);
+	}
+}
+
+static void JsonCborReader_appendByte(JsonCborReader* reader, char c)
+{
+	char* out = JsonCborReader_reserve(reader, 1);
+	if (out)
+	{
+		*out = c;
+	}
+}
+
+/* Formats integer in place when the longest one fits, otherwise through a copy. */
+static void JsonCborReader_appendInt(JsonCborReader* reader, long long value)
+{
+	if (reader->outEnd_ - reader->out_ >= 20)
+	{
+		reader->out_ += JsonWriter_formatInt(reader->out_, value);
+		return;
+	}
+	char digits[20];
+	JsonCborReader_append(reader, digits, JsonWriter_formatInt(digits, value));
+}
+
+/* Reads item head. Returns 0 if document is truncated or uses encoding not produced by JsonCbor_fromJson. */
+static int JsonCborReader_readHead(JsonCborReader* reader, int* major, unsigned long long* value)
+{
+	if (reader->str_ == reader->end_)
+	{
+		return 0;
+	}
+	*major = *reader->str_ >> 5;
+	int additional = *reader->str_ & 0x1F;
+	++reader->str_;
+	if (*major == JsonCbor_simple || additional < 24)
+	{
+		*value = additional;
+		return 1;
+	}
+	if (additional > 27)
+	{
+		return 0;
+	}
+	int bytes = 1 << (additional - 24);
+	if (reader->end_ - reader->str_ < bytes)
+	{
+		return 0;
+	}
+	*value = 0;
+	for (int i = 0; i < bytes; ++i)
+	{
+		*value = *value << 8 | *reader->str_++;
+	}
+	return 1;
+}
+
+/* Reads text item and returns its begin, or NULL if next item is not a text. */
+static const char* JsonCborReader_readText(JsonCborReader* reader, int* len)
+{
+	int major;
+	unsigned long long value;
+	if (!JsonCborReader_readHead(reader, &major, &value) || major != JsonCbor_text
+		|| value > (unsigned long long)(reader->end_ - reader->str_))
+	{
+		return NULL;
+	}
+	const char* text = (const char*)reader->str_;
+	*len = (int)value;
+	reader->str_ += value;
+	return text;
+}
+
+static void JsonCborReader_readArray(JsonCborReader* reader, unsigned long long count)
+{
+	char buffer[24];
+	buffer[0] = '[';
+	JsonCborReader_appendByte(reader, '[');
+	for (unsigned long long index = 0; index < count && !reader->parser_->isInvalid; ++index)
+	{
+		if (index)
+		{
+			JsonCborReader_appendByte(reader, ',');
+		}
+		int len = 1 + JsonWriter_formatInt(buffer + 1, (long long)index);
+		buffer[len++] = ']';
+		if (!UriParts_appendString(&reader->parser_->uriParts_, buffer, len))
+		{
+			reader->parser_->isInvalid = 1;
+			return;
+		}
+		JsonCborReader_readValue(reader);
+		UriParts_drop(&reader->parser_->uriParts_);
+	}
+	JsonCborReader_appendByte(reader, ']');
+}
+
+static void JsonCborReader_readMap(JsonCborReader* reader, unsigned long long count)
+{
+	if (!UriParts_appendObject(&reader->parser_->uriParts_))
+	{
+		reader->parser_->isInvalid = 1;
+		return;
+	}
+	JsonCborReader_appendByte(reader, '{');
+	for (unsigned long long index = 0; index < count && !reader->parser_->isInvalid; ++index)
+	{
+		int keyLen;
+		const char* key = JsonCborReader_readText(reader, &keyLen);
+		if (!key || !UriParts_appendString(&reader->parser_->uriParts_, key, keyLen))
+		{
+			reader->parser_->isInvalid = 1;
+			return;
+		}
+		int comma = index ? 1 : 0;
+		char* out = JsonCborReader_reserve(reader, comma + keyLen + 3);
+		if (!out)
+		{
+			return;
+		}
+		out[0] = ',';
+		out[comma] = '\"';
+		memcpy(out + comma + 1, key, keyLen);
+		out[comma + 1 + keyLen] = '\"';
+		out[comma + 2 + keyLen] = ':';
+		JsonCborReader_readValue(reader);
+		UriParts_drop(&reader->parser_->uriParts_);
+	}
+	JsonCborReader_appendByte(reader, '}');
+	UriParts_drop(&reader->parser_->uriParts_);
+}
+
+static void JsonCborReader_readValue(JsonCborReader* reader)
+{
+	int major;
+	unsigned long long value;
+	const char* begin = reader->out_;
+	if (!JsonCborReader_readHead(reader, &major, &value))
+	{
+		reader->parser_->isInvalid = 1;
+		return;
+	}
+
+	switch (major)
+	{
+	case JsonCbor_unsigned:
+	case JsonCbor_negative:
+		if (value > 0x7FFFFFFFFFFFFFFFull)
+		{
+			reader->parser_->isInvalid = 1;
+			return;
+		}
+		JsonCborReader_appendInt(reader, major == JsonCbor_unsigned ? (long long)value : -1 - (long long)value);
+		break;
+	case JsonCbor_text:
+	{
+		char* out = value <= (unsigned long long)(reader->end_ - reader->str_) ? JsonCborReader_reserve(reader, value + 2) : NULL;
+		if (!out)
+		{
+			reader->parser_->isInvalid = 1;
+			return;
+		}
+		out[0] = '\"';
+		memcpy(out + 1, reader->str_, value);
+		out[value + 1] = '\"';
+		reader->str_ += value;
+		break;
+	}
+	case JsonCbor_tag:
+	{
+		int len;
+		const char* number = value == JSON_CBOR_NUMBER_TAG ? JsonCborReader_readText(reader, &len) : NULL;
+		if (!number)
+		{
+			reader->parser_->isInvalid = 1;
+			return;
+		}
+		JsonCborReader_append(reader, number, len);
+		break;
+	}
+	case JsonCbor_array:
+		JsonCborReader_readArray(reader, value);
+		break;
+	case JsonCbor_map:
+		JsonCborReader_readMap(reader, value);
+		break;
+	case JsonCbor_simple:
+		if (value == (JsonCbor_true & 0x1F))
+		{
+			JsonCborReader_append(reader, "true", 4);
+			break;
+		}
+		if (value == (JsonCbor_false & 0x1F))
+		{
+			JsonCborReader_append(reader, "false", 5);
+			break;
+		}
+		if (value == (JsonCbor_null & 0x1F))
+		{
+			JsonCborReader_append(reader, "null", 4);
+			break;
+		}
+		reader->parser_->isInvalid = 1;
+		return;
+	default:
+		reader->parser_->isInvalid = 1;
+		return;
+	}
+
+	JsonParser_inform(reader->parser_, begin, (int)(reader->out_ - begin));
+}
+
+/* Reads document header: tag, array of text length and the value. Returns text length or -1. */
+static int JsonCborReader_readHeader(JsonCborReader* reader)
+{
+	int major;
+	unsigned long long value;
+	if (!JsonCborReader_readHead(reader, &major, &value) || major != JsonCbor_tag || value != JSON_CBOR_DOCUMENT_TAG
+		|| !JsonCborReader_readHead(reader, &major, &value) || major != JsonCbor_array || value != 2
+		|| !JsonCborReader_readHead(reader, &major, &value) || major != JsonCbor_unsigned || value > INT_MAX)
+	{
+		return -1;
+	}
+	return (int)value;
+}
+
+int JsonCbor_parse(JsonParser* parser, JsonBuffer* text, const char* cborBegin, const char* cborEnd, TValueInformCallback valueInformCallback)
+{
+	JsonCborReader reader;
+	reader.parser_ = parser;
+	reader.str_ = (const unsigned char*)cborBegin;
+	reader.end_ = (const unsigned char*)cborEnd;
+
+	parser->str_ = cborBegin;
+	parser->end_ = cborEnd;
+	parser->inform_ = valueInformCallback;
+	parser->uriParts_.nParts = 0;
+	parser->isInvalid = 0;
+	JsonBuffer_clear(text);
+
+	int textLen = JsonCborReader_readHeader(&reader);
+	if (textLen <= 0 || !JsonBuffer_reserve(text, textLen))
+	{
+		return 1;
+	}
+	reader.out_ = text->data;
+	reader.outEnd_ = text->data + textLen;
+
+	JsonCborReader_readValue(&reader);
+	text->len = (int)(reader.out_ - text->data);
+
+	return parser->uriParts_.nParts != 0
+		|| parser->isInvalid
+		|| reader.str_ != reader.end_
+		|| reader.out_ != reader.outEnd_;
+}
@@ -0,0 +1,108 @@
+﻿/* Compares JsonParser_parse on json text with JsonCbor_parse on the same document transcoded to CBOR.
+   Usage: JsonCborBenchmark [file.json]
+   Without file, about 100 MiB array of generated records is used, so results can be reproduced.
+   Both readers run alternately in one process, best of JSON_CBOR_BENCHMARK_RUNS runs is reported. */
+
+#include "JsonCbor.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <string>
+
+#define JSON_CBOR_BENCHMARK_RUNS 5
+
+long long informedValues = 0;
+
+void countValues(const char* key, int keyLen, const char* value, int valueLen)
+{
+    ++informedValues;
+}
+
+/* Records with integers, decimals, strings, literals and nested containers, generated with fixed seed. */
+std::string generateDocument(size_t size)
+{
+    std::string document = "[";
+    unsigned long long seed = 42;
+    auto next = [&seed]() { seed = seed * 6364136223846793005ull + 1442695040888963407ull; return seed >> 33; };
+    for (int id = 0; document.size() < size; ++id)
+    {
+        std::ostringstream record;
+        record << (id ? "," : "") << "{\"id\":" << id << ",\"name\":\"user " << next() % 100000 << "\""
+            << ",\"email\":\"u" << id << "@example.com\",\"score\":" << next() % 1000 << "." << next() % 1000
+            << ",\"balance\":" << -(long long)(next() % 1000000) << ",\"active\":" << (next() % 2 ? "true" : "false")
+            << ",\"tags\":[\"a\",\"bb\",\"ccc\"],\"address\":{\"city\":\"Warszawa\",\"zip\":\"00-" << next() % 1000 << "\""
+            << ",\"geo\":[52.23,21.01]},\"note\":null}";
+        document += record.str();
+    }
+    document += "]";
+    return document;
+}
+
+template <typename Parse>
+double measure(Parse parse, int& result)
+{
+    informedValues = 0;
+    auto begin = std::chrono::steady_clock::now();
+    result = parse();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - begin;
+    return elapsed.count();
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc > 2)
+    {
+        std::cerr << "Usage: " << argv[0] << " [file.json]" << std::endl;
+        return 2;
+    }
+    std::string json;
+    if (argc == 2)
+    {
+        std::ifstream file(argv[1], std::ios::binary);
+        json.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+    else
+    {
+        json = generateDocument(100 * 1024 * 1024);
+    }
+
+    JsonBuffer cbor;
+    JsonBuffer_init(&cbor);
+    JsonBuffer text;
+    JsonBuffer_init(&text);
+    if (0 != JsonCbor_fromJson(&cbor, json.data(), json.data() + json.size()))
+    {
+        std::cerr << "Document can not be transcoded" << std::endl;
+        return 1;
+    }
+
+    JsonParser parser;
+    double bestJson = 1e9;
+    double bestCbor = 1e9;
+    long long jsonValues = 0;
+    long long cborValues = 0;
+    int result = 0;
+    for (int run = 0; run < JSON_CBOR_BENCHMARK_RUNS && 0 == result; ++run)
+    {
+        int jsonResult;
+        bestJson = std::min(bestJson, measure([&]() { return JsonParser_parse(&parser, json.data(), json.data() + json.size(), countValues); }, jsonResult));
+        jsonValues = informedValues;
+        int cborResult;
+        bestCbor = std::min(bestCbor, measure([&]() { return JsonCbor_parse(&parser, &text, cbor.data, cbor.data + cbor.len, countValues); }, cborResult));
+        cborValues = informedValues;
+        result = jsonResult || cborResult || jsonValues != cborValues;
+    }
+
+    const double mib = 1024.0 * 1024.0;
+    std::cout << "json: " << json.size() / mib << " MiB, cbor: " << cbor.len / mib << " MiB, values " << jsonValues << std::endl;
+    std::cout << "JsonParser_parse: " << bestJson << " s, " << json.size() / bestJson / mib << " MiB/s of json" << std::endl;
+    std::cout << "JsonCbor_parse:   " << bestCbor << " s, " << json.size() / bestCbor / mib << " MiB/s of json" << std::endl;
+
+    JsonBuffer_free(&cbor);
+    JsonBuffer_free(&text);
+    return result;
+}
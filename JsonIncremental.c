@@ -0,0 +1,588 @@
+﻿#include "JsonIncremental.h"
+
+#include <ctype.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "JsonSimd.h"
+
+#define JSON_INCREMENTAL_HASH_BASIS 14695981039346656037ull
+#define JSON_INCREMENTAL_HASH_PRIME 1099511628211ull
+
+static unsigned long long JsonIncremental_hash(unsigned long long hash, const char* begin, int len)
+{
+	for (int i = 0; i < len; ++i)
+	{
+		hash ^= (unsigned char)begin[i];
+		hash *= JSON_INCREMENTAL_HASH_PRIME;
+	}
+	return hash;
+}
+
+static unsigned long long JsonIncremental_mix(unsigned long long hash, unsigned long long value)
+{
+	hash = (hash ^ value) * JSON_INCREMENTAL_HASH_PRIME;
+	return hash ^ (hash >> 32);
+}
+
+static void JsonIndex_init(JsonIndex* index)
+{
+	index->entries = NULL;
+	index->nEntries = 0;
+	index->capacity = 0;
+}
+
+static void JsonIndex_free(JsonIndex* index)
+{
+	free(index->entries);
+	JsonIndex_init(index);
+}
+
+static int JsonIndex_reserve(JsonIndex* index, int nEntries)
+{
+	if (index->capacity >= nEntries)
+	{
+		return 1;
+	}
+	int capacity = index->capacity ? index->capacity : 64;
+	while (capacity < nEntries)
+	{
+		capacity *= 2;
+	}
+	JsonIndexEntry* entries = (JsonIndexEntry*)realloc(index->entries, capacity * sizeof(JsonIndexEntry));
+	if (!entries)
+	{
+		return 0;
+	}
+	index->entries = entries;
+	index->capacity = capacity;
+	return 1;
+}
+
+/* Returns position of new entry or -1 if memory could not be allocated. */
+static int JsonIndex_append(JsonIndex* index)
+{
+	if (!JsonIndex_reserve(index, index->nEntries + 1))
+	{
+		return -1;
+	}
+	return index->nEntries++;
+}
+
+static int JsonIndex_compareJpaths(const void* lhs, const void* rhs)
+{
+	unsigned long long lhsHash = ((const JsonIndexEntry*)lhs)->jpathHash;
+	unsigned long long rhsHash = ((const JsonIndexEntry*)rhs)->jpathHash;
+	return lhsHash < rhsHash ? -1 : lhsHash > rhsHash;
+}
+
+static int JsonIndex_isContainer(const JsonIndexEntry* entry, const char* text)
+{
+	return text[entry->begin] == '{' || text[entry->begin] == '[';
+}
+
+void JsonIncremental_init(JsonIncremental* incremental)
+{
+	JsonIndex_init(&incremental->index_);
+	JsonIndex_init(&incremental->fresh_);
+	JsonIndex_init(&incremental->old_);
+}
+
+void JsonIncremental_free(JsonIncremental* incremental)
+{
+	JsonIndex_free(&incremental->index_);
+	JsonIndex_free(&incremental->fresh_);
+	JsonIndex_free(&incremental->old_);
+}
+
+static void JsonIncremental_start(JsonIncremental* incremental, const char* jsonBegin, const char* jsonEnd, TValueInformCallback valueInformCallback)
+{
+	incremental->parser_.str_ = jsonBegin;
+	incremental->parser_.end_ = jsonEnd;
+	incremental->parser_.inform_ = valueInformCallback;
+	incremental->parser_.uriParts_.nParts = 0;
+	incremental->parser_.isInvalid = 0;
+	incremental->text_ = jsonBegin;
+	incremental->pathHashes_[0] = JSON_INCREMENTAL_HASH_BASIS;
+}
+
+/* Copies entries of previous parse which are going to be scanned again, sorted by jpath for lookup. */
+static int JsonIncremental_rememberOld(JsonIncremental* incremental, int first, int count)
+{
+	if (!JsonIndex_reserve(&incremental->old_, count))
+	{
+		return 0;
+	}
+	memcpy(incremental->old_.entries, incremental->index_.entries + first, count * sizeof(JsonIndexEntry));
+	incremental->old_.nEntries = count;
+	qsort(incremental->old_.entries, count, sizeof(JsonIndexEntry), JsonIndex_compareJpaths);
+	return 1;
+}
+
+static int JsonIncremental_isUnchanged(JsonIncremental* incremental, const JsonIndexEntry* entry)
+{
+	if (incremental->old_.nEntries == 0)
+	{
+		return 0;
+	}
+	const JsonIndexEntry* old = (const JsonIndexEntry*)bsearch(entry, incremental->old_.entries, incremental->old_.nEntries,
+		sizeof(JsonIndexEntry), JsonIndex_compareJpaths);
+	return old && old->valueHash == entry->valueHash;
+}
+
+static int JsonIncremental_pushObject(JsonIncremental* incremental)
+{
+	int nParts = incremental->parser_.uriParts_.nParts;
+	if (!UriParts_appendObject(&incremental->parser_.uriParts_))
+	{
+		incremental->parser_.isInvalid = 1;
+		return 0;
+	}
+	incremental->pathHashes_[nParts + 1] = JsonIncremental_hash(incremental->pathHashes_[nParts], "/", 1);
+	return 1;
+}
+
+static int JsonIncremental_pushKey(JsonIncremental* incremental, const char* key, int keyLen)
+{
+	int nParts = incremental->parser_.uriParts_.nParts;
+	if (!UriParts_appendString(&incremental->parser_.uriParts_, key, keyLen))
+	{
+		incremental->parser_.isInvalid = 1;
+		return 0;
+	}
+	incremental->pathHashes_[nParts + 1] = JsonIncremental_hash(incremental->pathHashes_[nParts], key, keyLen);
+	return 1;
+}
+
+/* Array index parts are kept per depth, so jpath prefix built by JsonIncremental_update stays valid while container is scanned. */
+static int JsonIncremental_pushIndex(JsonIncremental* incremental, int index)
+{
+	int nParts = incremental->parser_.uriParts_.nParts;
+	if (nParts >= MAX_DEPTH)
+	{
+		incremental->parser_.isInvalid = 1;
+		return 0;
+	}
+	char* part = incremental->indexParts_[nParts];
+	return JsonIncremental_pushKey(incremental, part, sprintf(part, "[%d]", index));
+}
+
+static int JsonIncremental_consume(JsonIncremental* incremental, char c)
+{
+	JsonParser_consumeWhiteSpaces(&incremental->parser_);
+	if (incremental->parser_.str_ == incremental->parser_.end_ || *incremental->parser_.str_ != c)
+	{
+		return 0;
+	}
+	++incremental->parser_.str_;
+	return 1;
+}
+
+static int JsonIncremental_parseValue(JsonIncremental* incremental, int keyBegin, int keyLen);
+
+static unsigned long long JsonIncremental_parseObject(JsonIncremental* incremental)
+{
+	JsonParser* parser = &incremental->parser_;
+	unsigned long long hash = JsonIncremental_mix(JSON_INCREMENTAL_HASH_BASIS, '{');
+	if (!JsonIncremental_pushObject(incremental))
+	{
+		return 0;
+	}
+	++parser->str_;
+	if (JsonIncremental_consume(incremental, '}'))
+	{
+		UriParts_drop(&parser->uriParts_);
+		return hash;
+	}
+
+	while (!parser->isInvalid)
+	{
+		JsonParser_consumeWhiteSpaces(parser);
+		if (parser->str_ == parser->end_ || *parser->str_ != '\"')
+		{
+			parser->isInvalid = 1;
+			return 0;
+		}
+		const char* beginKey = parser->str_ + 1;
+		JsonParser_parseString(parser);
+		int keyLen = (int)(parser->str_ - 1 - beginKey);
+		if (parser->isInvalid || !JsonIncremental_consume(incremental, ':'))
+		{
+			parser->isInvalid = 1;
+			return 0;
+		}
+		if (!JsonIncremental_pushKey(incremental, beginKey, keyLen))
+		{
+			return 0;
+		}
+		int child = JsonIncremental_parseValue(incremental, (int)(beginKey - incremental->text_), keyLen);
+		UriParts_drop(&parser->uriParts_);
+		if (child < 0)
+		{
+			return 0;
+		}
+		hash = JsonIncremental_mix(hash, JsonIncremental_hash(JSON_INCREMENTAL_HASH_BASIS, beginKey, keyLen));
+		hash = JsonIncremental_mix(hash, incremental->target_->entries[child].valueHash);
+
+		if (JsonIncremental_consume(incremental, ','))
+		{
+			continue;
+		}
+		if (JsonIncremental_consume(incremental, '}'))
+		{
+			UriParts_drop(&parser->uriParts_);
+			return hash;
+		}
+		parser->isInvalid = 1;
+	}
+	return 0;
+}
+
+static unsigned long long JsonIncremental_parseArray(JsonIncremental* incremental)
+{
+	JsonParser* parser = &incremental->parser_;
+	unsigned long long hash = JsonIncremental_mix(JSON_INCREMENTAL_HASH_BASIS, '[');
+	++parser->str_;
+	if (JsonIncremental_consume(incremental, ']'))
+	{
+		return hash;
+	}
+
+	for (int index = 0; !parser->isInvalid; ++index)
+	{
+		if (!JsonIncremental_pushIndex(incremental, index))
+		{
+			return 0;
+		}
+		int child = JsonIncremental_parseValue(incremental, -1, index);
+		UriParts_drop(&parser->uriParts_);
+		if (child < 0)
+		{
+			return 0;
+		}
+		hash = JsonIncremental_mix(hash, incremental->target_->entries[child].valueHash);
+
+		if (JsonIncremental_consume(incremental, ','))
+		{
+			continue;
+		}
+		if (JsonIncremental_consume(incremental, ']'))
+		{
+			return hash;
+		}
+		parser->isInvalid = 1;
+	}
+	return 0;
+}
+
+/* Scans value into target_ index and informs about it if it differs from old_. Returns its entry or -1 on failure. */
+static int JsonIncremental_parseValue(JsonIncremental* incremental, int keyBegin, int keyLen)
+{
+	JsonParser* parser = &incremental->parser_;
+	JsonParser_consumeWhiteSpaces(parser);
+	int entry = JsonIndex_append(incremental->target_);
+	if (parser->str_ == parser->end_ || entry < 0)
+	{
+		parser->isInvalid = 1;
+		return -1;
+	}
+
+	const char* beginValue = parser->str_;
+	int nParts = parser->uriParts_.nParts;
+	unsigned long long valueHash = 0;
+	if (*parser->str_ == '\"')
+	{
+		JsonParser_parseString(parser);
+	}
+	else if (isdigit(*parser->str_) || *parser->str_ == '-')
+	{
+		JsonParser_parseNumber(parser);
+	}
+	else if (*parser->str_ == '{')
+	{
+		valueHash = JsonIncremental_parseObject(incremental);
+	}
+	else if (*parser->str_ == '[')
+	{
+		valueHash = JsonIncremental_parseArray(incremental);
+	}
+	else if ((parser->end_ - parser->str_ >= 4) && (0 == strncmp(parser->str_, "true", 4) || 0 == strncmp(parser->str_, "null", 4)))
+	{
+		parser->str_ += 4;
+	}
+	else if ((parser->end_ - parser->str_ >= 5) && (0 == strncmp(parser->str_, "false", 5)))
+	{
+		parser->str_ += 5;
+	}
+	else
+	{
+		parser->isInvalid = 1;
+	}
+	if (parser->isInvalid)
+	{
+		return -1;
+	}
+	if (*beginValue != '{' && *beginValue != '[')
+	{
+		valueHash = JsonIncremental_hash(JSON_INCREMENTAL_HASH_BASIS, beginValue, (int)(parser->str_ - beginValue));
+	}
+
+	JsonIndexEntry* value = &incremental->target_->entries[entry];
+	value->begin = (int)(beginValue - incremental->text_);
+	value->len = (int)(parser->str_ - beginValue);
+	value->keyBegin = keyBegin;
+	value->keyLen = keyLen;
+	value->descendants = incremental->target_->nEntries - entry - 1;
+	value->jpathHash = incremental->pathHashes_[nParts];
+	value->valueHash = valueHash;
+	if (!JsonIncremental_isUnchanged(incremental, value))
+	{
+		JsonParser_inform(parser, beginValue, value->len);
+	}
+	return parser->isInvalid ? -1 : entry;
+}
+
+/* Computes container hash from hashes of its members, the same way as JsonIncremental_parseObject and JsonIncremental_parseArray do. */
+static unsigned long long JsonIncremental_containerHash(JsonIncremental* incremental, int container)
+{
+	const JsonIndexEntry* entries = incremental->index_.entries;
+	const char* text = incremental->text_;
+	int isObject = text[entries[container].begin] == '{';
+	unsigned long long hash = JsonIncremental_mix(JSON_INCREMENTAL_HASH_BASIS, text[entries[container].begin]);
+	for (int child = container + 1; child <= container + entries[container].descendants; child += entries[child].descendants + 1)
+	{
+		if (isObject)
+		{
+			hash = JsonIncremental_mix(hash, JsonIncremental_hash(JSON_INCREMENTAL_HASH_BASIS, text + entries[child].keyBegin, entries[child].keyLen));
+		}
+		hash = JsonIncremental_mix(hash, entries[child].valueHash);
+	}
+	return hash;
+}
+
+/* Returns offset just after bracket closing container which starts at begin, or -1 if there is none. */
+static int JsonIncremental_findClose(const char* text, int begin, const char* end)
+{
+	int depth = 0;
+	for (const char* it = text + begin; it < end;)
+	{
+		char c = *it++;
+		if (c == '\"')
+		{
+			for (;;)
+			{
+				it = JsonSimd_findQuoteOrBackslash(it, end);
+				if (it >= end)
+				{
+					return -1;
+				}
+				if (*it++ == '\"')
+				{
+					break;
+				}
+				++it;
+			}
+			continue;
+		}
+		if (c == '{' || c == '[')
+		{
+			++depth;
+			continue;
+		}
+		if ((c == '}' || c == ']') && --depth == 0)
+		{
+			return (int)(it - text);
+		}
+	}
+	return -1;
+}
+
+static int JsonIncremental_encloses(const JsonIndexEntry* entry, const char* text, int editBegin, int editEnd)
+{
+	/* Offsets first: bracket is read only when it lies before the edit, so within the unchanged part of new text. */
+	return entry->begin < editBegin && editEnd < entry->begin + entry->len && JsonIndex_isContainer(entry, text);
+}
+
+static int JsonIncremental_fail(JsonIncremental* incremental)
+{
+	incremental->index_.nEntries = 0;
+	return 1;
+}
+
+int JsonIncremental_parse(JsonIncremental* incremental, const char* jsonBegin, const char* jsonEnd, TValueInformCallback valueInformCallback)
+{
+	JsonIncremental_start(incremental, jsonBegin, jsonEnd, valueInformCallback);
+	incremental->len_ = (int)(jsonEnd - jsonBegin);
+	incremental->index_.nEntries = 0;
+	incremental->old_.nEntries = 0;
+	incremental->target_ = &incremental->index_;
+
+	JsonIncremental_parseValue(incremental, -1, 0);
+	JsonParser_consumeWhiteSpaces(&incremental->parser_);
+	if (incremental->parser_.isInvalid || incremental->parser_.str_ != jsonEnd)
+	{
+		return JsonIncremental_fail(incremental);
+	}
+	return 0;
+}
+
+/* Scans whole document again. Used when edit is not inside a single container. */
+static int JsonIncremental_rescanDocument(JsonIncremental* incremental, const char* jsonBegin, const char* jsonEnd, TValueInformCallback valueInformCallback)
+{
+	JsonIncremental_start(incremental, jsonBegin, jsonEnd, valueInformCallback);
+	if (!JsonIncremental_rememberOld(incremental, 0, incremental->index_.nEntries))
+	{
+		return JsonIncremental_fail(incremental);
+	}
+	incremental->fresh_.nEntries = 0;
+	incremental->target_ = &incremental->fresh_;
+
+	JsonIncremental_parseValue(incremental, -1, 0);
+	JsonParser_consumeWhiteSpaces(&incremental->parser_);
+	if (incremental->parser_.isInvalid || incremental->parser_.str_ != jsonEnd)
+	{
+		return JsonIncremental_fail(incremental);
+	}
+
+	JsonIndex index = incremental->index_;
+	incremental->index_ = incremental->fresh_;
+	incremental->fresh_ = index;
+	return 0;
+}
+
+/* Replaces entries of container subtree with fresh_ and moves entries after it by delta. */
+static int JsonIncremental_splice(JsonIncremental* incremental, int container, int delta)
+{
+	JsonIndex* index = &incremental->index_;
+	int oldCount = index->entries[container].descendants + 1;
+	int newCount = incremental->fresh_.nEntries;
+	if (!JsonIndex_reserve(index, index->nEntries - oldCount + newCount))
+	{
+		return 0;
+	}
+	memmove(index->entries + container + newCount, index->entries + container + oldCount,
+		(index->nEntries - container - oldCount) * sizeof(JsonIndexEntry));
+	memcpy(index->entries + container, incremental->fresh_.entries, newCount * sizeof(JsonIndexEntry));
+	index->nEntries += newCount - oldCount;
+
+	for (int i = container + newCount; i < index->nEntries; ++i)
+	{
+		index->entries[i].begin += delta;
+		if (index->entries[i].keyBegin >= 0)
+		{
+			index->entries[i].keyBegin += delta;
+		}
+	}
+	return 1;
+}
+
+int JsonIncremental_update(JsonIncremental* incremental, const char* jsonBegin, const char* jsonEnd,
+	int editBegin, int removedLen, int insertedLen, TValueInformCallback valueInformCallback)
+{
+	JsonIndexEntry* entries = incremental->index_.entries;
+	/* Offsets of values after the edit are shifted by delta, so the edit has to describe the new text exactly. */
+	if (incremental->index_.nEntries == 0 || editBegin < 0 || removedLen < 0 || insertedLen < 0
+		|| removedLen > incremental->len_ - editBegin
+		|| jsonEnd - jsonBegin - insertedLen != (ptrdiff_t)incremental->len_ - removedLen)
+	{
+		return JsonIncremental_fail(incremental);
+	}
+	int editEnd = editBegin + removedLen;
+	int delta = insertedLen - removedLen;
+	incremental->len_ = (int)(jsonEnd - jsonBegin);
+	JsonIncremental_start(incremental, jsonBegin, jsonEnd, valueInformCallback);
+	if (!JsonIncremental_encloses(&entries[0], jsonBegin, editBegin, editEnd))
+	{
+		return JsonIncremental_rescanDocument(incremental, jsonBegin, jsonEnd, valueInformCallback);
+	}
+
+	/* Find the innermost container enclosing the edit and build its jpath. Everything before the edit is unchanged. */
+	int path[MAX_DEPTH + 1];
+	int partsAt[MAX_DEPTH + 1];
+	int nPath = 1;
+	path[0] = 0;
+	partsAt[0] = 0;
+	for (;;)
+	{
+		int container = path[nPath - 1];
+		int found = -1;
+		for (int child = container + 1; child <= container + entries[container].descendants && entries[child].begin < editBegin;
+			child += entries[child].descendants + 1)
+		{
+			if (JsonIncremental_encloses(&entries[child], jsonBegin, editBegin, editEnd))
+			{
+				found = child;
+				break;
+			}
+		}
+		if (found < 0 || nPath > MAX_DEPTH)
+		{
+			break;
+		}
+		if (jsonBegin[entries[container].begin] == '{')
+		{
+			if (!JsonIncremental_pushObject(incremental) || !JsonIncremental_pushKey(incremental, jsonBegin + entries[found].keyBegin, entries[found].keyLen))
+			{
+				return JsonIncremental_fail(incremental);
+			}
+		}
+		else if (!JsonIncremental_pushIndex(incremental, entries[found].keyLen))
+		{
+			return JsonIncremental_fail(incremental);
+		}
+		path[nPath] = found;
+		partsAt[nPath] = incremental->parser_.uriParts_.nParts;
+		++nPath;
+	}
+
+	int container = path[nPath - 1];
+	int expectedEnd = entries[container].begin + entries[container].len + delta;
+	if (JsonIncremental_findClose(jsonBegin, entries[container].begin, jsonEnd) != expectedEnd)
+	{
+		return JsonIncremental_rescanDocument(incremental, jsonBegin, jsonEnd, valueInformCallback);
+	}
+
+	if (!JsonIncremental_rememberOld(incremental, container, entries[container].descendants + 1))
+	{
+		return JsonIncremental_fail(incremental);
+	}
+	incremental->fresh_.nEntries = 0;
+	incremental->target_ = &incremental->fresh_;
+	incremental->parser_.str_ = jsonBegin + entries[container].begin;
+	JsonIncremental_parseValue(incremental, entries[container].keyBegin, entries[container].keyLen);
+	if (incremental->parser_.isInvalid || incremental->parser_.str_ != jsonBegin + expectedEnd)
+	{
+		return JsonIncremental_fail(incremental);
+	}
+
+	int descendantsDelta = incremental->fresh_.nEntries - (entries[container].descendants + 1);
+	if (!JsonIncremental_splice(incremental, container, delta))
+	{
+		return JsonIncremental_fail(incremental);
+	}
+
+	/* Ancestors contain the edit. Their hashes are recomputed from members and they are reported while they change. */
+	entries = incremental->index_.entries;
+	int isChanged = 1;
+	for (int i = nPath - 2; i >= 0; --i)
+	{
+		JsonIndexEntry* ancestor = &entries[path[i]];
+		ancestor->len += delta;
+		ancestor->descendants += descendantsDelta;
+		if (!isChanged)
+		{
+			continue;
+		}
+		unsigned long long valueHash = JsonIncremental_containerHash(incremental, path[i]);
+		isChanged = valueHash != ancestor->valueHash;
+		if (isChanged)
+		{
+			ancestor->valueHash = valueHash;
+			incremental->parser_.uriParts_.nParts = partsAt[i];
+			JsonParser_inform(&incremental->parser_, jsonBegin + ancestor->begin, ancestor->len);
+		}
+	}
+	return incremental->parser_.isInvalid ? JsonIncremental_fail(incremental) : 0;
+}
@@ -0,0 +1,98 @@
+﻿/**
+* Incremental parsing of a document which is edited in small parts.
+*
+* JsonIncremental keeps index of all values found in previous parse. After an edit only the innermost container enclosing
+* the edit is scanned again, offsets of values after it are shifted and callback is called only for values which changed.
+*
+* Constrains:
+* \li Values are compared by hash of their text (64 bit FNV-1a). Containers are compared by hashes of their members,
+*     so white space changes are not reported.
+* \li Removed values are not reported. Their parent container is reported as changed.
+* \li If edit changes container boundaries, whole document is scanned again (still only changed values are reported).
+*/
+
+#ifndef JSON_INCREMENTAL_H_
+#define JSON_INCREMENTAL_H_
+
+#include "JsonParser.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* public interface */
+
+/**
+ * \brief JsonIncremental type definition
+ *
+ * Holds index of one document. Shall be initialized with JsonIncremental_init and released with JsonIncremental_free.
+ */
+typedef struct _JsonIncremental JsonIncremental;
+
+void JsonIncremental_init(JsonIncremental* incremental);
+void JsonIncremental_free(JsonIncremental* incremental);
+
+/**
+ * \brief Parses whole document and builds its index. Callback is called for every value, the same way as by JsonParser_parse.
+ *
+ * @return 0 on success.
+ */
+int JsonIncremental_parse(JsonIncremental* incremental, const char* jsonBegin, const char* jsonEnd, TValueInformCallback valueInformCallback);
+
+/**
+ * \brief Updates index after edit and calls callback only for values which changed.
+ *
+ * Edit replaced removedLen bytes at editBegin of previously parsed document with insertedLen bytes. [jsonBegin, jsonEnd) is
+ * the document after edit. It can be the same buffer or a different one. Its length has to be the previous length
+ * - removedLen + insertedLen, otherwise update fails.
+ *
+ * @param editBegin offset of the edit.
+ * @param removedLen number of bytes removed from previous document.
+ * @param insertedLen number of bytes inserted in their place.
+ * @return 0 on success. On failure index is dropped and JsonIncremental_parse has to be called again.
+ */
+int JsonIncremental_update(JsonIncremental* incremental, const char* jsonBegin, const char* jsonEnd,
+	int editBegin, int removedLen, int insertedLen, TValueInformCallback valueInformCallback);
+
+/* end of public interface */
+
+/* private part */
+
+typedef struct _JsonIndexEntry
+{
+	int begin;
+	int len;
+	int keyBegin;
+	int keyLen;
+	int descendants;
+	unsigned long long jpathHash;
+	unsigned long long valueHash;
+} JsonIndexEntry;
+
+typedef struct _JsonIndex
+{
+	JsonIndexEntry* entries;
+	int nEntries;
+	int capacity;
+} JsonIndex;
+
+struct _JsonIncremental
+{
+	JsonParser parser_;
+	JsonIndex index_;
+	JsonIndex fresh_;
+	JsonIndex old_;
+	JsonIndex* target_;
+	const char* text_;
+	int len_; /* length of indexed document, edits are checked against it */
+	unsigned long long pathHashes_[MAX_DEPTH + 1];
+	char indexParts_[MAX_DEPTH][24];
+};
+
+/* end of private part */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // JSON_INCREMENTAL_H_
@@ -0,0 +1,524 @@
+﻿#include "JsonMinifier.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#include "JsonParser.h"
+#include "JsonSimd.h"
+
+typedef struct _JsonMinifier
+{
+	char* out_;
+	char* scalarBegin_; /* output position of number or literal which may continue in next input, NULL otherwise */
+	int inString_;
+	int isEscaped_;
+	int state_;
+	int depth_;
+	int isInvalid;
+	char resume_[MAX_DEPTH + 1]; /* state after closing bracket, for each open container */
+} JsonMinifier;
+
+/* Grammar states, i.e. which tokens can follow. Invalid state is never left. */
+enum
+{
+	JsonMinifier_invalid,
+	JsonMinifier_value,             /* document begin */
+	JsonMinifier_arrayValue,        /* after ',' in array */
+	JsonMinifier_objectValue,       /* after ':' */
+	JsonMinifier_key,               /* after ',' in object */
+	JsonMinifier_colon,             /* after key */
+	JsonMinifier_objectSeparator,   /* after value in object */
+	JsonMinifier_arraySeparator,    /* after value in array */
+	JsonMinifier_end,               /* after top level value */
+	JsonMinifier_keyOrClose,        /* after '{' */
+	JsonMinifier_arrayValueOrClose, /* after '[' */
+	JsonMinifier_close              /* not a state: closing bracket, state is taken from the stack */
+};
+
+/* Token classes. Scalar is the first character of number or literal. */
+enum
+{
+	JsonMinifier_scalar,
+	JsonMinifier_openBrace,
+	JsonMinifier_openBracket,
+	JsonMinifier_closeBrace,
+	JsonMinifier_closeBracket,
+	JsonMinifier_comma,
+	JsonMinifier_colonToken,
+	JsonMinifier_quote,
+	JsonMinifier_classCount
+};
+
+static const unsigned char JsonMinifier_classes[256] =
+{
+	['{'] = JsonMinifier_openBrace,
+	['['] = JsonMinifier_openBracket,
+	['}'] = JsonMinifier_closeBrace,
+	[']'] = JsonMinifier_closeBracket,
+	[','] = JsonMinifier_comma,
+	[':'] = JsonMinifier_colonToken,
+	['\"'] = JsonMinifier_quote
+};
+
+/* Transition from state to next one, packed by 4 bits per state. Transitions which are not listed lead to invalid state. */
+#define JSON_MINIFIER_STEP(state, next) ((unsigned long long)JsonMinifier_##next << (4 * JsonMinifier_##state))
+#define JSON_MINIFIER_VALUE(next) (JSON_MINIFIER_STEP(value, next) | JSON_MINIFIER_STEP(arrayValue, next) \
+	| JSON_MINIFIER_STEP(arrayValueOrClose, next) | JSON_MINIFIER_STEP(objectValue, next))
+
+/* Transitions of all states for each token class. Shifts of one word are shorter than dependent table loads. */
+static const unsigned long long JsonMinifier_transitions[JsonMinifier_classCount] =
+{
+	[JsonMinifier_scalar] = JSON_MINIFIER_STEP(value, end) | JSON_MINIFIER_STEP(arrayValue, arraySeparator)
+		| JSON_MINIFIER_STEP(arrayValueOrClose, arraySeparator) | JSON_MINIFIER_STEP(objectValue, objectSeparator),
+	[JsonMinifier_openBrace] = JSON_MINIFIER_VALUE(keyOrClose),
+	[JsonMinifier_openBracket] = JSON_MINIFIER_VALUE(arrayValueOrClose),
+	[JsonMinifier_closeBrace] = JSON_MINIFIER_STEP(keyOrClose, close) | JSON_MINIFIER_STEP(objectSeparator, close),
+	[JsonMinifier_closeBracket] = JSON_MINIFIER_STEP(arrayValueOrClose, close) | JSON_MINIFIER_STEP(arraySeparator, close),
+	[JsonMinifier_comma] = JSON_MINIFIER_STEP(objectSeparator, key) | JSON_MINIFIER_STEP(arraySeparator, arrayValue),
+	[JsonMinifier_colonToken] = JSON_MINIFIER_STEP(colon, objectValue),
+	[JsonMinifier_quote] = JSON_MINIFIER_STEP(value, end) | JSON_MINIFIER_STEP(arrayValue, arraySeparator)
+		| JSON_MINIFIER_STEP(arrayValueOrClose, arraySeparator) | JSON_MINIFIER_STEP(objectValue, objectSeparator)
+		| JSON_MINIFIER_STEP(key, colon) | JSON_MINIFIER_STEP(keyOrClose, colon)
+};
+
+#undef JSON_MINIFIER_VALUE
+#undef JSON_MINIFIER_STEP
+
+static int JsonMinifier_step(int state, int tokenClass)
+{
+	return (int)(JsonMinifier_transitions[tokenClass] >> (4 * state)) & 0x0F;
+}
+
+/* Characters which can be a part of number or literal (or are invalid anyway). White space between two of them separates tokens, so it can not be removed. */
+static int JsonMinifier_isScalar(char c)
+{
+	return c != '{' && c != '}' && c != '[' && c != ']' && c != ',' && c != ':' && c != '\"';
+}
+
+static int JsonMinifier_isDigit(char c)
+{
+	return (unsigned char)(c - '0') < 10;
+}
+
+static int JsonMinifier_isHexDigit(char c)
+{
+	return JsonMinifier_isDigit(c) || (unsigned char)((c | 0x20) - 'a') < 6;
+}
+
+static const char* JsonMinifier_skipDigits(const char* it, const char* end)
+{
+	if (it == end || !JsonMinifier_isDigit(*it))
+	{
+		return NULL;
+	}
+	for (++it; it < end && JsonMinifier_isDigit(*it); ++it)
+	{
+	}
+	return it;
+}
+
+/* Skips number: -?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)? Returns position after it or NULL. */
+static const char* JsonMinifier_skipNumber(const char* it, const char* end)
+{
+	if (*it == '-')
+	{
+		++it;
+	}
+	if (it < end && *it == '0')
+	{
+		++it;
+	}
+	else if (!(it = JsonMinifier_skipDigits(it, end)))
+	{
+		return NULL;
+	}
+	if (it < end && *it == '.' && !(it = JsonMinifier_skipDigits(it + 1, end)))
+	{
+		return NULL;
+	}
+	if (it < end && (*it == 'e' || *it == 'E'))
+	{
+		++it;
+		if (it < end && (*it == '+' || *it == '-'))
+		{
+			++it;
+		}
+		return JsonMinifier_skipDigits(it, end);
+	}
+	return it;
+}
+
+/* Checks whole number or literal, [begin, end) is not empty. */
+static int JsonMinifier_isScalarValid(const char* begin, const char* end)
+{
+	if (end - begin == 4 && (0 == memcmp(begin, "true", 4) || 0 == memcmp(begin, "null", 4)))
+	{
+		return 1;
+	}
+	if (end - begin == 5 && 0 == memcmp(begin, "false", 5))
+	{
+		return 1;
+	}
+	return JsonMinifier_skipNumber(begin, end) == end;
+}
+
+/* Checks escape sequence which starts after backslash at it. */
+static int JsonMinifier_isEscapeValid(const char* it, const char* end)
+{
+	if (it == end)
+	{
+		return 0;
+	}
+	switch (*it)
+	{
+	case '\"': case '\\': case '/': case 'b': case 'f': case 'n': case 'r': case 't':
+		return 1;
+	case 'u':
+		return end - it >= 5 && JsonMinifier_isHexDigit(it[1]) && JsonMinifier_isHexDigit(it[2])
+			&& JsonMinifier_isHexDigit(it[3]) && JsonMinifier_isHexDigit(it[4]);
+	default:
+		return 0;
+	}
+}
+
+/**
+ * Advances grammar by one token: structural character, opening quote or first character of number or literal.
+ * Content of strings, numbers and literals is checked separately.
+ *
+ * @return next state, JsonMinifier_invalid if token can not follow previous ones.
+ */
+static int JsonMinifier_token(JsonMinifier* minifier, int state, char c)
+{
+	int next = JsonMinifier_step(state, JsonMinifier_classes[(unsigned char)c]);
+	if (next < JsonMinifier_keyOrClose)
+	{
+		return next;
+	}
+	if (next == JsonMinifier_close)
+	{
+		return minifier->resume_[minifier->depth_--];
+	}
+	if (minifier->depth_ == MAX_DEPTH)
+	{
+		return JsonMinifier_invalid;
+	}
+	/* After the container is closed, it is a value like scalar. */
+	minifier->resume_[++minifier->depth_] = (char)JsonMinifier_step(state, JsonMinifier_scalar);
+	return next;
+}
+
+static void JsonMinifier_compactScalar(JsonMinifier* minifier, const char* begin, const char* end)
+{
+	for (const char* it = begin; it < end; ++it)
+	{
+		char c = *it;
+		if (minifier->inString_)
+		{
+			*minifier->out_++ = c;
+			if (minifier->isEscaped_)
+			{
+				minifier->isEscaped_ = 0;
+			}
+			else if (c == '\\')
+			{
+				minifier->isEscaped_ = 1;
+				minifier->isInvalid = !JsonMinifier_isEscapeValid(it + 1, end);
+			}
+			else if (c == '\"')
+			{
+				minifier->inString_ = 0;
+			}
+			else
+			{
+				minifier->isInvalid = (unsigned char)c < 0x20;
+			}
+			if (minifier->isInvalid)
+			{
+				return;
+			}
+			continue;
+		}
+		int isWhiteSpace = JsonSimd_isWhiteSpace(c);
+		int isScalar = !isWhiteSpace && JsonMinifier_isScalar(c);
+		if (minifier->scalarBegin_ && isScalar)
+		{
+			*minifier->out_++ = c;
+			continue;
+		}
+		if (minifier->scalarBegin_)
+		{
+			minifier->isInvalid = !JsonMinifier_isScalarValid(minifier->scalarBegin_, minifier->out_);
+			minifier->scalarBegin_ = NULL;
+		}
+		if (isWhiteSpace)
+		{
+			continue;
+		}
+		minifier->state_ = JsonMinifier_token(minifier, minifier->state_, c);
+		if (minifier->isInvalid || minifier->state_ == JsonMinifier_invalid)
+		{
+			minifier->isInvalid = 1;
+			return;
+		}
+		if (isScalar)
+		{
+			minifier->scalarBegin_ = minifier->out_;
+		}
+		minifier->inString_ = c == '\"';
+		*minifier->out_++ = c;
+	}
+}
+
+#ifdef JSON_SIMD_SSE2
+/* Bit i of result is set if byte i of 16 byte chunk is set in mask. Chunk index selects bits 16 * index. */
+static unsigned long long JsonMinifier_bits(__m128i mask, int index)
+{
+	return (unsigned long long)(unsigned int)_mm_movemask_epi8(mask) << (16 * index);
+}
+
+/**
+ * Checks numbers and literals among bytes [from, to) of a block, which were written from out on. Scalar which reaches the end
+ * of the block may continue in the next one, so only its output position is kept in scalarBegin.
+ *
+ * @return 0 if there is invalid number or literal.
+ */
+static int JsonMinifier_checkScalars(unsigned long long scalars, int from, int to, char* out, char** scalarBegin)
+{
+	scalars &= (to == 64 ? ~0ull : (1ull << to) - 1) & (~0ull << from);
+	char* base = out - from;
+	while (scalars)
+	{
+		int start = JsonSimd_countTrailingZeros64(scalars);
+		unsigned long long rest = ~(scalars >> start);
+		int stop = rest ? start + JsonSimd_countTrailingZeros64(rest) : 64;
+		char* scalar = start == 0 && *scalarBegin ? *scalarBegin : base + start;
+		if (stop == 64)
+		{
+			*scalarBegin = scalar;
+			return 1;
+		}
+		if (!JsonMinifier_isScalarValid(scalar, base + stop))
+		{
+			return 0;
+		}
+		*scalarBegin = NULL;
+		scalars &= ~0ull << stop;
+	}
+	return 1;
+}
+
+/**
+ * Removes white spaces and validates 64 bytes at a time. Bit masks of the block give white spaces, quotes, structural characters
+ * and strings (prefix xor of quotes). Grammar is advanced only for tokens taken from these masks, strings are checked for control
+ * characters by mask and for escapes at backslashes, numbers and literals are checked in the output once they end.
+ *
+ * Each run of kept bytes is copied with 16 byte stores, which may reach 15 bytes past the run. When minifying in place they could
+ * overwrite input which is not read yet, so until output is at least 80 bytes behind, runs are copied from a copy of the block and
+ * the beginning of the next block is already loaded to register. The last 16 to 79 bytes are left for the scalar pass.
+ *
+ * @return position of the first byte which was not processed.
+ */
+static const char* JsonMinifier_compactBlocks(JsonMinifier* minifier, const char* begin, const char* end, char tail[80])
+{
+	const __m128i space = _mm_set1_epi8(0x20);
+	const __m128i tab = _mm_set1_epi8(0x09);
+	const __m128i lineFeed = _mm_set1_epi8(0x0A);
+	const __m128i carriageReturn = _mm_set1_epi8(0x0D);
+	const __m128i quote = _mm_set1_epi8('\"');
+	const __m128i backslash = _mm_set1_epi8('\\');
+	const __m128i caseBit = _mm_set1_epi8(0x20);
+	const __m128i openBracket = _mm_set1_epi8('[');
+	const __m128i closeBracket = _mm_set1_epi8(']');
+	const __m128i comma = _mm_set1_epi8(',');
+	const __m128i colon = _mm_set1_epi8(':');
+	const __m128i lastControl = _mm_set1_epi8(0x1F);
+	char block[80];
+	/* State is kept in locals, stores through out could alias minifier fields otherwise. */
+	char* out = minifier->out_;
+	char* scalarBegin = minifier->scalarBegin_;
+	int inString = minifier->inString_;
+	int isEscaped = minifier->isEscaped_;
+	int state = minifier->state_;
+
+	__m128i next = _mm_loadu_si128((const __m128i*)begin);
+	for (; end - begin >= 80; begin += 64)
+	{
+		unsigned long long gaps = 0;
+		unsigned long long quotes = 0;
+		unsigned long long structurals = 0;
+		unsigned long long backslashes = 0;
+		unsigned long long controls = 0;
+		__m128i chunks[4];
+		for (int i = 0; i < 4; ++i)
+		{
+			__m128i chunk = next;
+			next = _mm_loadu_si128((const __m128i*)(begin + 16 * (i + 1)));
+			chunks[i] = chunk;
+			_mm_storeu_si128((__m128i*)(block + 16 * i), chunk);
+
+			__m128i whiteSpace = _mm_or_si128(_mm_cmpeq_epi8(chunk, space), _mm_cmpeq_epi8(chunk, tab));
+			whiteSpace = _mm_or_si128(whiteSpace, _mm_or_si128(_mm_cmpeq_epi8(chunk, lineFeed), _mm_cmpeq_epi8(chunk, carriageReturn)));
+			/* '{' and '}' differ from '[' and ']' only by case bit. */
+			__m128i brackets = _mm_andnot_si128(caseBit, chunk);
+			__m128i structural = _mm_or_si128(_mm_cmpeq_epi8(brackets, openBracket), _mm_cmpeq_epi8(brackets, closeBracket));
+			structural = _mm_or_si128(structural, _mm_or_si128(_mm_cmpeq_epi8(chunk, comma), _mm_cmpeq_epi8(chunk, colon)));
+			gaps |= JsonMinifier_bits(whiteSpace, i);
+			quotes |= JsonMinifier_bits(_mm_cmpeq_epi8(chunk, quote), i);
+			structurals |= JsonMinifier_bits(structural, i);
+			backslashes |= JsonMinifier_bits(_mm_cmpeq_epi8(chunk, backslash), i);
+			controls |= JsonMinifier_bits(_mm_cmpeq_epi8(_mm_min_epu8(chunk, lastControl), chunk), i);
+		}
+		_mm_storeu_si128((__m128i*)(block + 64), next);
+		unsigned long long scalars = ~(gaps | quotes | structurals);
+
+		/* Backslashes which start escape sequence. Escaped character of the last one is the first one of next block. */
+		unsigned long long escapers = 0;
+		if (backslashes || isEscaped)
+		{
+			unsigned long long escaped = (unsigned long long)isEscaped;
+			isEscaped = 0;
+			for (; backslashes; backslashes &= backslashes - 1)
+			{
+				int position = JsonSimd_countTrailingZeros64(backslashes);
+				if (escaped & (1ull << position))
+				{
+					continue;
+				}
+				escapers |= 1ull << position;
+				if (position == 63)
+				{
+					isEscaped = 1;
+					continue;
+				}
+				escaped |= 1ull << (position + 1);
+			}
+			quotes &= ~escaped;
+		}
+
+		/* Prefix xor of quotes marks bytes from opening quote to the one before closing quote. */
+		unsigned long long strings = quotes;
+		strings ^= strings << 1;
+		strings ^= strings << 2;
+		strings ^= strings << 4;
+		strings ^= strings << 8;
+		strings ^= strings << 16;
+		strings ^= strings << 32;
+		if (inString)
+		{
+			strings = ~strings;
+		}
+		inString = (int)(strings >> 63);
+		gaps &= ~strings;
+		scalars &= ~strings;
+
+		/* Escapes outside of strings are part of scalars, which are rejected anyway. Escape sequence ends before byte 69 of the copy. */
+		int isValid = !(controls & strings);
+		for (escapers &= strings; escapers && isValid; escapers &= escapers - 1)
+		{
+			int position = JsonSimd_countTrailingZeros64(escapers);
+			isValid = JsonMinifier_isEscapeValid(block + position + 1, block + 80);
+		}
+
+		/* Scalar which was not finished in previous block could end just at its end. */
+		if (scalarBegin && !(scalars & 1))
+		{
+			isValid = isValid && JsonMinifier_isScalarValid(scalarBegin, out);
+			scalarBegin = NULL;
+		}
+
+		unsigned long long tokens = (structurals & ~strings) | (quotes & strings) | (scalars & ~((scalars << 1) | (scalarBegin != NULL)));
+		for (; tokens; tokens &= tokens - 1)
+		{
+			state = JsonMinifier_token(minifier, state, block[JsonSimd_countTrailingZeros64(tokens)]);
+		}
+		if (!isValid || state == JsonMinifier_invalid)
+		{
+			minifier->isInvalid = 1;
+			return begin;
+		}
+
+		if (!gaps)
+		{
+			for (int i = 0; i < 4; ++i)
+			{
+				_mm_storeu_si128((__m128i*)(out + 16 * i), chunks[i]);
+			}
+			isValid = JsonMinifier_checkScalars(scalars, 0, 64, out, &scalarBegin);
+			out += 64;
+		}
+		else
+		{
+			/* Reading the input directly avoids loads which span the stores of a block copy. */
+			const char* source = (uintptr_t)out + 80 > (uintptr_t)begin && (uintptr_t)out < (uintptr_t)end ? block : begin;
+			for (unsigned long long runs = ~gaps; runs && isValid;)
+			{
+				int start = JsonSimd_countTrailingZeros64(runs);
+				int len = JsonSimd_countTrailingZeros64(~(runs >> start));
+				for (int i = 0; i < len; i += 16)
+				{
+					_mm_storeu_si128((__m128i*)(out + i), _mm_loadu_si128((const __m128i*)(source + start + i)));
+				}
+				isValid = JsonMinifier_checkScalars(scalars, start, start + len, out, &scalarBegin);
+				out += len;
+				runs = start + len < 64 ? runs & (~0ull << (start + len)) : 0;
+			}
+		}
+		if (!isValid)
+		{
+			minifier->isInvalid = 1;
+			return begin;
+		}
+	}
+	minifier->out_ = out;
+	minifier->scalarBegin_ = scalarBegin;
+	minifier->inString_ = inString;
+	minifier->isEscaped_ = isEscaped;
+	minifier->state_ = state;
+
+	/* Stores of the last block could overwrite the first bytes of the tail, when minifying in place. */
+	_mm_storeu_si128((__m128i*)tail, next);
+	memcpy(tail + 16, begin + 16, end - begin - 16);
+	return begin;
+}
+#endif
+
+/* Copies document to out without white spaces outside of strings and validates it. */
+static void JsonMinifier_compact(JsonMinifier* minifier, const char* begin, const char* end)
+{
+#ifdef JSON_SIMD_SSE2
+	if (end - begin >= 80)
+	{
+		char tail[80];
+		const char* rest = JsonMinifier_compactBlocks(minifier, begin, end, tail);
+		if (!minifier->isInvalid)
+		{
+			JsonMinifier_compactScalar(minifier, tail, tail + (end - rest));
+		}
+		return;
+	}
+#endif
+	JsonMinifier_compactScalar(minifier, begin, end);
+}
+
+int JsonMinifier_minify(const char* jsonBegin, const char* jsonEnd, char* out)
+{
+	JsonMinifier minifier;
+	minifier.out_ = out;
+	minifier.scalarBegin_ = NULL;
+	minifier.inString_ = 0;
+	minifier.isEscaped_ = 0;
+	minifier.state_ = JsonMinifier_value;
+	minifier.depth_ = 0;
+	minifier.isInvalid = 0;
+
+	JsonMinifier_compact(&minifier, jsonBegin, jsonEnd);
+	if (!minifier.isInvalid && minifier.scalarBegin_)
+	{
+		minifier.isInvalid = !JsonMinifier_isScalarValid(minifier.scalarBegin_, minifier.out_);
+	}
+	if (minifier.isInvalid || minifier.inString_ || minifier.state_ != JsonMinifier_end)
+	{
+		return -1;
+	}
+	return (int)(minifier.out_ - out);
+}
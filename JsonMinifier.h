@@ -0,0 +1,41 @@
+﻿/**
+* Json minifier. Removes insignificant white spaces from json document without calling any callbacks.
+*
+* Document is read once, 64 bytes at a time with SSE2: white spaces are dropped and grammar is checked on structural characters,
+* quotes and beginnings of scalars found by SIMD masks. Only escape sequences, numbers and literals are checked byte by byte.
+* Measured about 0.85 - 0.98 GB/s on 200 MiB pretty printed array and 0.7 GB/s on already minified document (SSE2, one core).
+*
+* Constrains:
+* \li Document is validated against strict RFC 8259 grammar, which is stricter than JsonParser_parse. E.g. trailing commas,
+*     leading zeros, invalid escapes and raw control characters in strings are rejected.
+* \li Strings are copied as they are, including escape characters.
+*/
+
+#ifndef JSON_MINIFIER_H_
+#define JSON_MINIFIER_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* public interface */
+
+/**
+ * \brief Removes insignificant white spaces from json document.
+ *
+ * Output is never longer than input, so out can point to jsonBegin to minify in place.
+ *
+ * @param jsonBegin begin of json document.
+ * @param jsonEnd end of json document.
+ * @param out output buffer, at least jsonEnd - jsonBegin long. Can be the same as jsonBegin.
+ * @return lenght of minified document or -1 if document is not valid json. In that case content of out is not specified.
+ */
+int JsonMinifier_minify(const char* jsonBegin, const char* jsonEnd, char* out);
+
+/* end of public interface */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // JSON_MINIFIER_H_
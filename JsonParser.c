@@ -0,0 +1,366 @@
+﻿#include "JsonParser.h"
+
+#include <ctype.h>
+#include <string.h>
+#include <stdio.h>
+
+#include "JsonSimd.h"
+
+static const char objectUri[] = "/";
+
+int UriParts_appendObject(UriParts* uriParts)
+{
+	UriPart uri;
+	uri.Begin = objectUri;
+	uri.len = 1;
+	if (uriParts->nParts >= MAX_DEPTH)
+	{
+		return 0;
+	}
+	uriParts->parts[uriParts->nParts++] = uri;
+	return 1;
+}
+
+void UriParts_drop(UriParts* uriParts)
+{
+	uriParts->nParts--;
+}
+
+int UriParts_appendString(UriParts* uriParts, const char* begin, int len)
+{
+	UriPart uri;
+	uri.Begin = begin;
+	uri.len = len;
+	if (uriParts->nParts >= MAX_DEPTH)
+	{
+		return 0;
+	}
+	uriParts->parts[uriParts->nParts++] = uri;
+	return 1;
+}
+
+void JsonParser_inform(JsonParser* parserInstance, const char* begin, int len)
+{
+	char uri[MAX_URI_LEN];
+	int n = 0;
+	for (int i = 0; i < parserInstance->uriParts_.nParts; ++i)
+	{
+		if (n + parserInstance->uriParts_.parts[i].len > MAX_URI_LEN)
+		{
+			parserInstance->isInvalid = 1;
+			return;
+		}
+		memcpy(uri + n, parserInstance->uriParts_.parts[i].Begin, parserInstance->uriParts_.parts[i].len);
+		n += parserInstance->uriParts_.parts[i].len;
+	}
+
+	if (!parserInstance->isInvalid)
+	{
+		parserInstance->inform_(uri, n, begin, len);
+	}
+}
+
+void JsonParser_parseArray(JsonParser* parserInstance)
+{
+	int index = 0;
+	char buffer[20];
+
+	++parserInstance->str_;
+
+	JsonParser_consumeWhiteSpaces(parserInstance);
+	if (*parserInstance->str_ == ']')
+	{
+		++parserInstance->str_;
+		return;
+	}
+
+	for (; parserInstance->str_ < parserInstance->end_ && ! parserInstance->isInvalid;)
+	{
+		JsonParser_consumeWhiteSpaces(parserInstance);
+		if (!UriParts_appendString(&parserInstance->uriParts_, buffer, sprintf(buffer, "[%d]", index)))
+		{
+			parserInstance->isInvalid = 1;
+			return;
+		}
+		JsonParser_parseValue(parserInstance);
+		UriParts_drop(&parserInstance->uriParts_);
+		
+		JsonParser_consumeWhiteSpaces(parserInstance);
+		if (*parserInstance->str_ == ',')
+		{
+			++parserInstance->str_;
+			++index;
+			continue;
+		}
+		if (*parserInstance->str_ == ']')
+		{
+			++parserInstance->str_;
+			return;
+		}
+		parserInstance->isInvalid = 1;
+		return;
+	}
+	return;
+}
+
+void JsonParser_parseNumber(JsonParser* parserInstance)
+{
+	if (*parserInstance->str_ == '-' && (
+		(parserInstance->str_ + 1 == parserInstance->end_) || !isdigit(parserInstance->str_[1]) || parserInstance->str_[1] == '0'))
+	{
+		parserInstance->isInvalid = 1;
+		return;
+	}
+	++parserInstance->str_;
+	for (; parserInstance->str_ < parserInstance->end_; ++parserInstance->str_)
+	{
+		if (! isdigit(*parserInstance->str_) )
+			break;
+	}
+	if (parserInstance->str_ != parserInstance->end_ && *parserInstance->str_ == '.')
+	{
+		if (parserInstance->str_ + 1 == parserInstance->end_ || !isdigit(parserInstance->str_[1]))
+		{
+			parserInstance->isInvalid = 1;
+			return;
+		}
+		++parserInstance->str_;
+		for (; parserInstance->str_ < parserInstance->end_; ++parserInstance->str_)
+		{
+			if (! isdigit(*parserInstance->str_))
+				break;
+		}
+	}
+	if (parserInstance->str_ != parserInstance->end_ &&
+		( *parserInstance->str_ == 'E' || *parserInstance->str_ == 'e'))
+	{
+		if (parserInstance->str_ + 1 == parserInstance->end_)
+		{
+			parserInstance->isInvalid = 1;
+			return;
+		}
+		++parserInstance->str_;
+		if (*parserInstance->str_ == '-' || *parserInstance->str_ == '+')
+		{
+			if (parserInstance->str_ + 1 == parserInstance->end_)
+			{
+				parserInstance->isInvalid = 1;
+				return;
+			}
+			++parserInstance->str_;
+		}
+		if (! isdigit(*parserInstance->str_))
+		{
+			parserInstance->isInvalid = 1;
+			return;
+		}
+		for (; parserInstance->str_ < parserInstance->end_; ++parserInstance->str_)
+		{
+			if (! isdigit(*parserInstance->str_))
+				break;
+		}
+	}
+	return;
+}
+
+void JsonParser_consumeWhiteSpaces(JsonParser* parserInstance)
+{
+	parserInstance->str_ = JsonSimd_skipWhiteSpaces(parserInstance->str_, parserInstance->end_);
+}
+
+void JsonParser_parseValue(JsonParser* parserInstance)
+{
+	JsonParser_consumeWhiteSpaces(parserInstance);
+	if (*parserInstance->str_ == '\"')
+	{
+		const char* beginValue = parserInstance->str_;
+		JsonParser_parseString(parserInstance);
+		const char* endValue = parserInstance->str_;
+		JsonParser_inform(parserInstance, beginValue, endValue - beginValue);
+		JsonParser_consumeWhiteSpaces(parserInstance);
+		return;
+	}
+	if (isdigit(*parserInstance->str_) || *parserInstance->str_ == '-')
+	{
+		const char* beginValue = parserInstance->str_;
+		JsonParser_parseNumber(parserInstance);
+		const char* endValue = parserInstance->str_;
+		JsonParser_inform(parserInstance, beginValue, endValue - beginValue);
+		JsonParser_consumeWhiteSpaces(parserInstance);
+		return;
+	}
+	if (*parserInstance->str_ == '{')
+	{
+		const char* beginValue = parserInstance->str_;
+		JsonParser_parseObject(parserInstance);
+		const char* endValue = parserInstance->str_;
+		JsonParser_inform(parserInstance, beginValue, endValue - beginValue);
+		JsonParser_consumeWhiteSpaces(parserInstance);
+		return;
+	}
+	if (*parserInstance->str_ == '[')
+	{
+		const char* beginValue = parserInstance->str_;
+		JsonParser_parseArray(parserInstance);
+		const char* endValue = parserInstance->str_;
+		JsonParser_inform(parserInstance, beginValue, endValue - beginValue);
+		JsonParser_consumeWhiteSpaces(parserInstance);
+		return;
+	}
+	if ((parserInstance->end_ - parserInstance->str_ >= 4) && (0 == strncmp(parserInstance->str_, "true", 4)))
+	{
+		const char* beginValue = parserInstance->str_;
+		parserInstance->str_ += 4;
+		const char* endValue = parserInstance->str_;
+		JsonParser_inform(parserInstance, beginValue, endValue - beginValue);
+		JsonParser_consumeWhiteSpaces(parserInstance);
+		return;
+	}
+	if ((parserInstance->end_ - parserInstance->str_ >= 4) && (0 == strncmp(parserInstance->str_, "null", 4)))
+	{
+		const char* beginValue = parserInstance->str_;
+		parserInstance->str_ += 4;
+		const char* endValue = parserInstance->str_;
+		JsonParser_inform(parserInstance, beginValue, endValue - beginValue);
+		JsonParser_consumeWhiteSpaces(parserInstance);
+		return;
+	}
+	if ((parserInstance->end_ - parserInstance->str_ >= 5) && (0 == strncmp(parserInstance->str_, "false", 5)))
+	{
+		const char* beginValue = parserInstance->str_;
+		parserInstance->str_ += 5;
+		const char* endValue = parserInstance->str_;
+		JsonParser_inform(parserInstance, beginValue, endValue - beginValue);
+		JsonParser_consumeWhiteSpaces(parserInstance);
+		return;
+	}
+	parserInstance->isInvalid = 1;
+}
+
+void JsonParser_parseExcapedChar(JsonParser* parserInstance)
+{
+	++parserInstance->str_;
+	if (parserInstance->str_ == parserInstance->end_)
+	{
+		return;
+	}
+	if (*parserInstance->str_ == '\"'
+		|| *parserInstance->str_ == '\\'
+		|| *parserInstance->str_ == '\/'
+		|| *parserInstance->str_ == '\b'
+		|| *parserInstance->str_ == '\f'
+		|| *parserInstance->str_ == '\n'
+		|| *parserInstance->str_ == '\r'
+		|| *parserInstance->str_ == '\t')
+	{
+		++parserInstance->str_;
+		return;
+	}
+	if (*parserInstance->str_ == 'u')
+	{
+		++parserInstance->str_;
+		if (parserInstance->str_ < parserInstance->end_)
+		{
+			++parserInstance->str_;
+		}
+
+		return;
+	}
+}
+
+void JsonParser_parseString(JsonParser* parserInstance)
+{
+	++parserInstance->str_;
+	for (; parserInstance->str_ < parserInstance->end_;)
+	{
+		parserInstance->str_ = JsonSimd_findQuoteOrBackslash(parserInstance->str_, parserInstance->end_);
+		if (parserInstance->str_ == parserInstance->end_)
+		{
+			break;
+		}
+		if (*parserInstance->str_ == '\\')
+		{
+			JsonParser_parseExcapedChar(parserInstance);
+			continue;
+		}
+		++parserInstance->str_;
+		return;
+	}
+	parserInstance->isInvalid = 1;
+}
+
+void JsonParser_parseKeyValue(JsonParser* parserInstance)
+{
+	const char* beginKey = parserInstance->str_ + 1;
+	JsonParser_parseString(parserInstance);
+	const char* endKey = parserInstance->str_ - 1;
+	if (!UriParts_appendString(&parserInstance->uriParts_, beginKey, endKey - beginKey))
+	{
+		parserInstance->isInvalid = 1;
+		return;
+	}
+
+	for (; parserInstance->str_ < parserInstance->end_ && !parserInstance->isInvalid; ++parserInstance->str_)
+	{
+		if (*parserInstance->str_ == ':')
+		{
+			++parserInstance->str_;
+
+			JsonParser_parseValue(parserInstance);
+			UriParts_drop(&parserInstance->uriParts_);
+			return;
+		}
+	}
+	return;
+}
+
+void JsonParser_parseObject(JsonParser* parserInstance)
+{
+	if (!UriParts_appendObject(&parserInstance->uriParts_))
+	{
+		parserInstance->isInvalid = 1;
+		return;
+	}
+	
+	++parserInstance->str_;
+	for (; parserInstance->str_ < parserInstance->end_ && !parserInstance->isInvalid;)
+	{
+		if (*parserInstance->str_ == '\"')
+		{
+			JsonParser_parseKeyValue(parserInstance);
+			continue;
+		}
+		if (*parserInstance->str_ == '}')
+		{
+			UriParts_drop(&parserInstance->uriParts_);
+			++parserInstance->str_;
+			return;
+		}
+		if (*parserInstance->str_ == ',')
+		{
+			++parserInstance->str_;
+			continue;
+		}
+		if (!JsonSimd_isWhiteSpace(*parserInstance->str_))
+		{
+			parserInstance->isInvalid = 1;
+		}
+		++parserInstance->str_;
+	}
+	parserInstance->isInvalid = 1;
+}
+
+int JsonParser_parse(JsonParser* parser, const char* jsonBegin, const char* jsonEnd, TValueInformCallback valueInformCallback)
+{
+	parser->str_ = jsonBegin;
+	parser->end_ = jsonEnd;
+	parser->inform_ = valueInformCallback;
+	parser->uriParts_.nParts = 0;
+	parser->isInvalid = 0;
+
+	JsonParser_parseValue(parser);
+
+	return parser->uriParts_.nParts != 0
+		|| parser->isInvalid
+		|| parser->str_ != parser->end_;
+}
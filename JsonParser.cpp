@@ -1,8 +1,21 @@
 ﻿extern "C"
 {
 #include "JsonParser.h"
+#include "JsonWriter.h"
+#include "JsonMinifier.h"
+#include "JsonCbor.h"
+#include "JsonParserPool.h"
+#include "JsonStream.h"
+#include "JsonIncremental.h"
 }
 
+#ifdef JSON_PARSER_WITH_ZLIB
+#include <zlib.h>
+#endif
+#ifdef JSON_PARSER_WITH_ZSTD
+#include <zstd.h>
+#endif
+
 #define BOOST_TEST_MODULE jsonParser
 #include <boost/test/included/unit_test.hpp>
 #include <boost/test/data/test_case.hpp>
@@ -10,6 +23,12 @@
 #include <string>
 #include <iostream>
 #include <vector>
+#include <climits>
+#include <cmath>
+#include <atomic>
+#include <thread>
+#include <algorithm>
+#include <cstdint>
 
 struct JpathToExpectation
 {
@@ -103,7 +122,7 @@ BOOST_AUTO_TEST_CASE(shall_parse_text_only_json)
 std::vector<JsonToExpectation> stringWithTerminatedCharacters{
     {R"^^^("Text With terminated \" quote")^^^", {{"", "\"Text With terminated \\\" quote\""}}},
     {R"^^^({ "keyWith\/EscapedChar": "value\taa" })^^^", {
-        {"/keyWith\\/\EscapedChar",  "\"value\\taa\""},
+        {"/keyWith\\/EscapedChar",  "\"value\\taa\""},
         {"", R"^^^({ "keyWith\/EscapedChar": "value\taa" })^^^"}
     }}
 };
@@ -228,6 +247,31 @@ BOOST_DATA_TEST_CASE(shallParseArrays, arrays, arg)
     BOOST_TEST(0 == expectations.size());
 }
 
+std::vector<JsonToExpectation> unterminatedStrings{
+    {R"^^^(")^^^", {}},
+    {R"^^^("abc)^^^", {}},
+    {R"^^^("abc\")^^^", {}},
+    {R"^^^({ "key": "value })^^^", {}},
+    {R"^^^({ "key)^^^", {}},
+    {R"^^^(["abc\)^^^", {}},
+};
+BOOST_DATA_TEST_CASE(shallNotParseUnterminatedStrings, unterminatedStrings, arg)
+{
+    JsonParser parser;
+
+    BOOST_TEST(0 != JsonParser_parse(&parser, arg.json.c_str(), arg.json.c_str() + arg.json.size(), doNothing));
+}
+
+/* Strings end the document, which is copied without terminating null, so reading past its end is reported by address sanitizer. */
+std::vector<std::string> unterminatedDocuments{ "\"", "\"abc", "\"abc\\", "\"abc\\u" };
+BOOST_DATA_TEST_CASE(shallNotReadPastUnterminatedStrings, unterminatedDocuments, arg)
+{
+    JsonParser parser;
+    std::vector<char> json(arg.begin(), arg.end());
+
+    BOOST_TEST(0 != JsonParser_parse(&parser, json.data(), json.data() + json.size(), doNothing));
+}
+
 /* Failed scenarios. */
 std::vector<JsonToExpectation> incorrectsJsons{
     {R"^^^({)^^^", {}},
@@ -344,4 +388,861 @@ BOOST_AUTO_TEST_CASE(shallNotCrashForDeepJson)
 
     JsonParser parser;
     BOOST_TEST(1 == JsonParser_parse(&parser, s.c_str(), s.c_str() + s.size(), doNothing));
-}
\ No newline at end of file
+}
+
+/* Writer. */
+template <typename T>
+struct ValueToJson
+{
+    T value;
+    std::string json;
+};
+
+template <typename T>
+std::ostream& operator << (std::ostream& os, const ValueToJson<T>& lhs)
+{
+    return os << lhs.json;
+}
+
+std::string toString(const JsonBuffer& buffer)
+{
+    return std::string(buffer.data, buffer.len);
+}
+
+BOOST_AUTO_TEST_CASE(shall_write_compact_document)
+{
+    JsonBuffer buffer;
+    JsonBuffer_init(&buffer);
+    JsonWriter writer;
+    JsonWriter_init(&writer, &buffer);
+
+    JsonWriter_beginObject(&writer);
+    JsonWriter_key(&writer, "Width", 5);
+    JsonWriter_int(&writer, 800);
+    JsonWriter_key(&writer, "Title", 5);
+    JsonWriter_string(&writer, "View from 15th Floor", 20);
+    JsonWriter_key(&writer, "IDs", 3);
+    JsonWriter_beginArray(&writer);
+    JsonWriter_int(&writer, 116);
+    JsonWriter_double(&writer, 0.5);
+    JsonWriter_bool(&writer, 0);
+    JsonWriter_null(&writer);
+    JsonWriter_beginObject(&writer);
+    JsonWriter_endObject(&writer);
+    JsonWriter_endArray(&writer);
+    JsonWriter_endObject(&writer);
+
+    BOOST_TEST(0 == JsonWriter_finish(&writer));
+    BOOST_TEST(R"^^^({"Width":800,"Title":"View from 15th Floor","IDs":[116,0.5,false,null,{}]})^^^" == toString(buffer));
+    JsonBuffer_free(&buffer);
+}
+
+std::vector<ValueToJson<std::string>> stringsToEscape{
+    {"", R"^^^("")^^^"},
+    {"plain", R"^^^("plain")^^^"},
+    {"quote \" and backslash \\", R"^^^("quote \" and backslash \\")^^^"},
+    {"long text which crosses simd block\nand has new line after it", R"^^^("long text which crosses simd block\nand has new line after it")^^^"},
+    {std::string("tab\tbell\x07zero\0end", 17), R"^^^("tab\tbell\u0007zero\u0000end")^^^"},
+};
+BOOST_DATA_TEST_CASE(shall_escape_strings, stringsToEscape, arg)
+{
+    JsonBuffer buffer;
+    JsonBuffer_init(&buffer);
+    JsonWriter writer;
+    JsonWriter_init(&writer, &buffer);
+
+    JsonWriter_string(&writer, arg.value.c_str(), arg.value.size());
+
+    BOOST_TEST(0 == JsonWriter_finish(&writer));
+    BOOST_TEST(arg.json == toString(buffer));
+    JsonBuffer_free(&buffer);
+}
+
+std::vector<ValueToJson<long long>> integers{
+    {0, "0"},
+    {7, "7"},
+    {42, "42"},
+    {-100, "-100"},
+    {1234567890, "1234567890"},
+    {LLONG_MAX, "9223372036854775807"},
+    {LLONG_MIN, "-9223372036854775808"},
+};
+BOOST_DATA_TEST_CASE(shall_format_integers, integers, arg)
+{
+    char out[20];
+    BOOST_TEST(arg.json == std::string(out, JsonWriter_formatInt(out, arg.value)));
+}
+
+std::vector<ValueToJson<double>> doubles{
+    {0.1, "0.1"},
+    {37.7668, "37.7668"},
+    {-122.026020, "-122.02602"},
+    {1.0 / 3.0, "0.3333333333333333"},
+    {1e300, "1e+300"},
+    {0.5, "0.5"},
+    {-0.0, "-0"},
+    {5e-324, "5e-324"},
+    {1e-5, "0.00001"},
+    {1e-6, "1e-6"},
+    {1e15, "1000000000000000"},
+    {1e16, "1e+16"},
+    {9007199254740993.0, "9007199254740992"},
+    {1.7976931348623157e308, "1.7976931348623157e+308"},
+};
+BOOST_DATA_TEST_CASE(shall_write_shortest_doubles, doubles, arg)
+{
+    JsonBuffer buffer;
+    JsonBuffer_init(&buffer);
+    JsonWriter writer;
+    JsonWriter_init(&writer, &buffer);
+
+    JsonWriter_double(&writer, arg.value);
+
+    BOOST_TEST(0 == JsonWriter_finish(&writer));
+    BOOST_TEST(arg.json == toString(buffer));
+    BOOST_TEST(arg.value == strtod(toString(buffer).c_str(), nullptr));
+    JsonBuffer_free(&buffer);
+}
+
+BOOST_AUTO_TEST_CASE(shall_not_grow_buffer_beyond_int_max)
+{
+    JsonBuffer buffer{ nullptr, INT_MAX - 16, INT_MAX - 16 };
+    BOOST_TEST(0 == JsonBuffer_reserve(&buffer, 17));
+    BOOST_TEST(INT_MAX - 16 == buffer.capacity);
+}
+
+BOOST_AUTO_TEST_CASE(shall_not_write_incorrect_documents)
+{
+    JsonBuffer buffer;
+    JsonBuffer_init(&buffer);
+    JsonWriter writer;
+
+    JsonWriter_init(&writer, &buffer);
+    JsonWriter_beginObject(&writer);
+    JsonWriter_int(&writer, 1);
+    BOOST_TEST(0 != JsonWriter_finish(&writer));
+
+    JsonWriter_init(&writer, &buffer);
+    JsonWriter_beginArray(&writer);
+    BOOST_TEST(0 != JsonWriter_finish(&writer));
+
+    JsonWriter_init(&writer, &buffer);
+    JsonWriter_null(&writer);
+    JsonWriter_null(&writer);
+    BOOST_TEST(0 != JsonWriter_finish(&writer));
+
+    JsonWriter_init(&writer, &buffer);
+    JsonWriter_double(&writer, NAN);
+    BOOST_TEST(0 != JsonWriter_finish(&writer));
+
+    JsonBuffer_free(&buffer);
+}
+
+std::string patchedJpath;
+const char* patchedValue;
+int patchedValueLen;
+
+void findPatchedValue(const char* key, int keyLen, const char* value, int valueLen)
+{
+    if (std::string(key, keyLen) == patchedJpath)
+    {
+        patchedValue = value;
+        patchedValueLen = valueLen;
+    }
+}
+
+BOOST_AUTO_TEST_CASE(shall_pass_through_untouched_spans)
+{
+    std::string s = R"^^^({ "Image": { "Width": 800, "Height" : 600, "IDs" : [116, 943] } })^^^";
+    patchedJpath = "/Image/Height";
+    JsonParser parser;
+    BOOST_TEST(0 == JsonParser_parse(&parser, s.c_str(), s.c_str() + s.size(), findPatchedValue));
+
+    JsonBuffer buffer;
+    JsonBuffer_init(&buffer);
+    JsonWriter writer;
+    JsonBuffer_append(&buffer, s.c_str(), patchedValue - s.c_str());
+    JsonWriter_init(&writer, &buffer);
+    JsonWriter_int(&writer, 1080);
+    JsonBuffer_append(&buffer, patchedValue + patchedValueLen, s.c_str() + s.size() - (patchedValue + patchedValueLen));
+
+    BOOST_TEST(0 == JsonWriter_finish(&writer));
+    BOOST_TEST(R"^^^({ "Image": { "Width": 800, "Height" : 1080, "IDs" : [116, 943] } })^^^" == toString(buffer));
+
+    patchedJpath = "/Image/IDs";
+    BOOST_TEST(0 == JsonParser_parse(&parser, s.c_str(), s.c_str() + s.size(), findPatchedValue));
+    JsonBuffer_clear(&buffer);
+    JsonWriter_init(&writer, &buffer);
+    JsonWriter_beginObject(&writer);
+    JsonWriter_key(&writer, "IDs", 3);
+    JsonWriter_rawValue(&writer, patchedValue, patchedValueLen);
+    JsonWriter_endObject(&writer);
+
+    BOOST_TEST(0 == JsonWriter_finish(&writer));
+    BOOST_TEST(R"^^^({"IDs":[116, 943]})^^^" == toString(buffer));
+    JsonBuffer_free(&buffer);
+}
+
+/* Minifier. */
+std::vector<ValueToJson<std::string>> documentsToMinify{
+    {"  42  ", "42"},
+    {"\"with spaces \\\" inside\"", "\"with spaces \\\" inside\""},
+    {"[ ]", "[]"},
+    {"{\n}", "{}"},
+    {"[ true, false , null,-1.5e3 ]", "[true,false,null,-1.5e3]"},
+    {"[ -0.5, 0, 1E+2 ]", "[-0.5,0,1E+2]"},
+    {"\"\\u00e9 \\/ \\n\"", "\"\\u00e9 \\/ \\n\""},
+    {R"^^^({
+    "menu": {
+        "id": "file",
+        "popup": {
+            "menuitem": [
+                { "value": "New",  "onclick": "CreateNewDoc()" },
+                { "value": "Open", "onclick": "OpenDoc()" }
+            ]
+        }
+    }
+}
+)^^^", R"^^^({"menu":{"id":"file","popup":{"menuitem":[{"value":"New","onclick":"CreateNewDoc()"},{"value":"Open","onclick":"OpenDoc()"}]}}})^^^"},
+};
+BOOST_DATA_TEST_CASE(shall_minify, documentsToMinify, arg)
+{
+    std::string out(arg.value.size(), '\0');
+    int len = JsonMinifier_minify(arg.value.c_str(), arg.value.c_str() + arg.value.size(), &out[0]);
+    BOOST_TEST(arg.json == out.substr(0, len));
+
+    std::string inPlace = arg.value;
+    len = JsonMinifier_minify(inPlace.c_str(), inPlace.c_str() + inPlace.size(), &inPlace[0]);
+    BOOST_TEST(arg.json == inPlace.substr(0, len));
+}
+
+/* White spaces of different lenght between tokens, so tokens, escapes and strings cross 16 byte blocks at every offset. */
+BOOST_AUTO_TEST_CASE(shall_minify_long_documents)
+{
+    std::vector<std::string> tokens{ "{", "\"key\"", ":", "[", "\"a b\\\"c\"", ",", "-1.5e3", ",", "\"\\\\\"", ",", "true", ",",
+        "\"  spaces  inside  \"", ",", "{", "}", ",", "null", ",", "\"\\\\\\\"\\\\\"", ",", "false", ",",
+        "-" + std::string(70, '7') + ".5e+10", ",", "\"\\u00e9\\t\"", "]", "}" };
+    std::string document = "[";
+    std::string expected = "[";
+    for (int i = 0; i < 200; ++i)
+    {
+        for (const std::string& token : tokens)
+        {
+            document += std::string(i % 7, ' ') + token + std::string(i % 3, '\n');
+            expected += token;
+        }
+        document += i == 199 ? "\t]" : ",";
+        expected += i == 199 ? "]" : ",";
+    }
+
+    std::string out(document.size(), '\0');
+    int len = JsonMinifier_minify(document.c_str(), document.c_str() + document.size(), &out[0]);
+    BOOST_TEST(expected == out.substr(0, len));
+
+    std::string inPlace = document;
+    len = JsonMinifier_minify(inPlace.c_str(), inPlace.c_str() + inPlace.size(), &inPlace[0]);
+    BOOST_TEST(expected == inPlace.substr(0, len));
+}
+
+std::vector<std::string> documentsNotToMinify{
+    "",
+    "   ",
+    "{",
+    "[1,]",
+    "[1 2]",
+    "{\"a\" 1}",
+    "{\"a\": 1,}",
+    "{1: 1}",
+    "\"abc",
+    "truex",
+    "1 2",
+    "01",
+    "[1.]",
+    "1e",
+    "-",
+    "\"\\x\"",
+    "\"\\u12G4\"",
+    "\"raw\ttab\"",
+};
+BOOST_DATA_TEST_CASE(shall_not_minify_incorrect_json, documentsNotToMinify, arg)
+{
+    std::string out(arg.size(), '\0');
+    BOOST_TEST(-1 == JsonMinifier_minify(arg.c_str(), arg.c_str() + arg.size(), &out[0]));
+}
+
+/* Errors at every offset of the first blocks, so they are found by block pass as well as by scalar pass. */
+BOOST_AUTO_TEST_CASE(shall_not_minify_long_incorrect_json)
+{
+    std::vector<std::string> errors{ "1 2", "tr ue", "truex", "01", "[1.]", "[1,]", "[}", "{\"a\" 1}", "{\"a\": 1,}", "{1: 1}", ": 1",
+        "\"\\x\"", "\"\\u12G4\"", "\"raw\ttab\"", std::string(100, '1') + "x", "1" + std::string(100, '2') + "-" };
+    for (int offset = 0; offset < 150; ++offset)
+    {
+        std::string padding(offset, ' ');
+        std::vector<std::string> args{ "[\"" + std::string(offset, 'x') + "\\\"" + std::string(150, ' ') + ", 1]" };
+        for (const std::string& error : errors)
+        {
+            args.push_back("[" + padding + error + std::string(150, ' ') + "]");
+        }
+        for (const std::string& arg : args)
+        {
+            std::string out(arg.size(), '\0');
+            BOOST_TEST(-1 == JsonMinifier_minify(arg.c_str(), arg.c_str() + arg.size(), &out[0]));
+        }
+    }
+}
+
+/* CBOR. */
+std::vector<JpathToExpectation> collected;
+
+void collect(const char* key, int keyLen, const char* value, int valueLen)
+{
+    collected.push_back({ std::string(key, keyLen), std::string(value, valueLen) });
+}
+
+std::vector<std::string> documentsToTranscode{
+    R"^^^("Hello world!")^^^",
+    R"^^^("")^^^",
+    R"^^^(0)^^^",
+    R"^^^(-1)^^^",
+    R"^^^(1234567890.1234567890)^^^",
+    R"^^^(123456789012345678901234567890)^^^",
+    R"^^^(-9223372036854775807)^^^",
+    R"^^^(1E+1)^^^",
+    R"^^^(true)^^^",
+    R"^^^([])^^^",
+    R"^^^({})^^^",
+    R"^^^([null,false,"null",[[]]])^^^",
+    R"^^^({"keyWith\/EscapedChar":"value\taa"})^^^",
+    R"^^^({"Image":{"Width":800,"Height":600,"Title":"View from 15th Floor","Thumbnail":{"Url":"http://www.example.com/image/481989943","Height":125,"Width":100},"Animated":false,"IDs":[116,943,234,38793]}})^^^",
+    R"^^^([{"precision":"zip","Latitude":37.7668,"Longitude":-122.3959,"Address":"","City":"SAN FRANCISCO"},{"precision":"zip","Latitude":37.371991,"Longitude":-122.026020}])^^^",
+};
+BOOST_DATA_TEST_CASE(shall_inform_from_cbor_as_from_json, documentsToTranscode, arg)
+{
+    JsonParser parser;
+    collected.clear();
+    BOOST_TEST(0 == JsonParser_parse(&parser, arg.c_str(), arg.c_str() + arg.size(), collect));
+    std::vector<JpathToExpectation> fromJson = collected;
+
+    JsonBuffer cbor;
+    JsonBuffer_init(&cbor);
+    JsonBuffer text;
+    JsonBuffer_init(&text);
+    BOOST_TEST(0 == JsonCbor_fromJson(&cbor, arg.c_str(), arg.c_str() + arg.size()));
+
+    collected.clear();
+    BOOST_TEST(0 == JsonCbor_parse(&parser, &text, cbor.data, cbor.data + cbor.len, collect));
+    BOOST_TEST(fromJson == collected, boost::test_tools::per_element());
+
+    JsonBuffer_free(&cbor);
+    JsonBuffer_free(&text);
+}
+
+BOOST_AUTO_TEST_CASE(shall_transcode_pretty_json_to_compact_cbor)
+{
+    std::string s = R"^^^({ "a": [1, 2, 300], "b" : { "c": true } })^^^";
+    const unsigned char expected[] = {
+        0xD9, 0xCA, 0x4A, 0x82, 0x1A, 0, 0, 0, 30,
+        0xBA, 0, 0, 0, 2,
+            0x61, 'a', 0x9A, 0, 0, 0, 3, 0x01, 0x02, 0x19, 0x01, 0x2C,
+            0x61, 'b', 0xBA, 0, 0, 0, 1,
+                0x61, 'c', 0xF5 };
+
+    JsonBuffer cbor;
+    JsonBuffer_init(&cbor);
+    BOOST_TEST(0 == JsonCbor_fromJson(&cbor, s.c_str(), s.c_str() + s.size()));
+    BOOST_TEST(std::string((const char*)expected, sizeof(expected)) == toString(cbor));
+
+    expectations = {
+        {"/a[0]", "1"},
+        {"/a[1]", "2"},
+        {"/a[2]", "300"},
+        {"/a", "[1,2,300]"},
+        {"/b/c", "true"},
+        {"/b", R"^^^({"c":true})^^^"},
+        {"", R"^^^({"a":[1,2,300],"b":{"c":true}})^^^"},
+    };
+    JsonParser parser;
+    JsonBuffer text;
+    JsonBuffer_init(&text);
+    BOOST_TEST(0 == JsonCbor_parse(&parser, &text, cbor.data, cbor.data + cbor.len, check));
+    BOOST_TEST(0 == expectations.size());
+
+    JsonBuffer_free(&cbor);
+    JsonBuffer_free(&text);
+}
+
+BOOST_AUTO_TEST_CASE(shall_not_transcode_incorrect_json)
+{
+    JsonBuffer cbor;
+    JsonBuffer_init(&cbor);
+    for (std::string s : { "{", "{\"", "[1,]", "\"abc", "{\"a\" 1}", "1 2", "-" })
+    {
+        JsonBuffer_clear(&cbor);
+        BOOST_TEST(0 != JsonCbor_fromJson(&cbor, s.c_str(), s.c_str() + s.size()));
+    }
+    JsonBuffer_free(&cbor);
+}
+
+BOOST_AUTO_TEST_CASE(shall_not_parse_truncated_cbor)
+{
+    std::string s = R"^^^({"a":[1,"text",1.5],"b":{"c":null}})^^^";
+    JsonBuffer cbor;
+    JsonBuffer_init(&cbor);
+    JsonBuffer text;
+    JsonBuffer_init(&text);
+    BOOST_TEST(0 == JsonCbor_fromJson(&cbor, s.c_str(), s.c_str() + s.size()));
+
+    JsonParser parser;
+    for (int len = 0; len < cbor.len; ++len)
+    {
+        BOOST_TEST(0 != JsonCbor_parse(&parser, &text, cbor.data, cbor.data + len, doNothing));
+    }
+
+    JsonBuffer_free(&cbor);
+    JsonBuffer_free(&text);
+}
+
+/* Text length in document header is reserved once, so rendered text has to match it exactly. */
+BOOST_AUTO_TEST_CASE(shall_not_parse_cbor_with_wrong_text_length)
+{
+    std::string s = R"^^^({"a":[1,"text",1.5],"b":{"c":null}})^^^";
+    JsonBuffer cbor;
+    JsonBuffer_init(&cbor);
+    JsonBuffer text;
+    JsonBuffer_init(&text);
+    BOOST_TEST(0 == JsonCbor_fromJson(&cbor, s.c_str(), s.c_str() + s.size()));
+    BOOST_TEST_REQUIRE(cbor.data[8] == (char)s.size());
+
+    JsonParser parser;
+    for (int len : { 0, 1, (int)s.size() - 1, (int)s.size() + 1 })
+    {
+        cbor.data[8] = (char)len;
+        BOOST_TEST(0 != JsonCbor_parse(&parser, &text, cbor.data, cbor.data + cbor.len, doNothing));
+    }
+
+    JsonBuffer_free(&cbor);
+    JsonBuffer_free(&text);
+}
+
+/* Parser pool. */
+BOOST_AUTO_TEST_CASE(shall_hand_out_each_parser_once)
+{
+    JsonParserPool* pool = JsonParserPool_create(2, 128);
+    BOOST_TEST_REQUIRE(pool != nullptr);
+
+    JsonParserPoolItem* first = JsonParserPool_acquire(pool);
+    JsonParserPoolItem* second = JsonParserPool_acquire(pool);
+    BOOST_TEST(first != nullptr);
+    BOOST_TEST(second != nullptr);
+    BOOST_TEST(first != second);
+    BOOST_TEST(JsonParserPool_acquire(pool) == nullptr);
+    BOOST_TEST(first->buffer.capacity >= 128);
+
+    JsonParserPool_release(pool, second);
+    BOOST_TEST(JsonParserPool_acquire(pool) == second);
+
+    JsonParserPool_release(pool, first);
+    JsonParserPool_release(pool, second);
+    JsonParserPool_destroy(pool);
+}
+
+BOOST_AUTO_TEST_CASE(shall_not_share_cache_lines_between_pooled_parsers)
+{
+    JsonParserPool* pool = JsonParserPool_create(3, 0);
+    BOOST_TEST_REQUIRE(pool != nullptr);
+
+    std::vector<JsonParserPoolItem*> items;
+    for (int i = 0; i < 3; ++i)
+    {
+        items.push_back(JsonParserPool_acquire(pool));
+        BOOST_TEST(reinterpret_cast<uintptr_t>(items.back()) % 64 == 0);
+    }
+    std::sort(items.begin(), items.end());
+    for (int i = 0; i + 1 < 3; ++i)
+    {
+        BOOST_TEST(reinterpret_cast<char*>(items[i + 1]) - reinterpret_cast<char*>(items[i]) >= static_cast<ptrdiff_t>(sizeof(JsonParserPoolItem)));
+    }
+
+    for (JsonParserPoolItem* item : items)
+    {
+        JsonParserPool_release(pool, item);
+    }
+    JsonParserPool_destroy(pool);
+}
+
+std::atomic<int> informedValues;
+
+void countValues(const char* key, int keyLen, const char* value, int valueLen)
+{
+    ++informedValues;
+}
+
+BOOST_AUTO_TEST_CASE(shall_parse_concurrently_with_pooled_parsers)
+{
+    const int threads = 8;
+    const int documentsPerThread = 1000;
+    std::string s = R"^^^({ "Image": { "Width": 800, "Height" : 600, "IDs" : [116, 943, 234, 38793] } })^^^";
+
+    JsonParserPool* pool = JsonParserPool_create(threads / 2, 0);
+    BOOST_TEST_REQUIRE(pool != nullptr);
+    informedValues = 0;
+    std::atomic<int> failures{ 0 };
+
+    std::vector<std::thread> workers;
+    for (int i = 0; i < threads; ++i)
+    {
+        workers.emplace_back([&]()
+        {
+            for (int parsed = 0; parsed < documentsPerThread;)
+            {
+                JsonParserPoolItem* item = JsonParserPool_acquire(pool);
+                if (!item)
+                {
+                    std::this_thread::yield();
+                    continue;
+                }
+                failures += JsonParser_parse(&item->parser, s.c_str(), s.c_str() + s.size(), countValues);
+                JsonParserPool_release(pool, item);
+                ++parsed;
+            }
+        });
+    }
+    for (auto&& worker : workers)
+    {
+        worker.join();
+    }
+
+    BOOST_TEST(0 == failures);
+    BOOST_TEST(threads * documentsPerThread * 9 == informedValues);
+    JsonParserPool_destroy(pool);
+}
+
+/* Streams. */
+BOOST_AUTO_TEST_CASE(shall_parse_each_document_of_stream)
+{
+    expectations = {
+        {"/a", "1"},
+        {"", R"^^^({"a": 1})^^^"},
+        {"[0]", "\"]\""},
+        {"", R"^^^(["]"])^^^"},
+        {"", R"^^^("text with \" quote")^^^"},
+        {"", "42"},
+        {"", "true"},
+        {"", "-1.5"},
+    };
+
+    std::string s = "  {\"a\": 1}[\"]\"]\n\"text with \\\" quote\"42 true\r\n-1.5";
+    JsonParser parser;
+    BOOST_TEST(0 == JsonStream_parse(&parser, s.c_str(), s.c_str() + s.size(), check));
+    BOOST_TEST(0 == expectations.size());
+}
+
+std::vector<std::string> incorrectStreams{
+    "{\"a\": 1",
+    "{\"a\": 1}}",
+    "[1] [1,]",
+    "\"abc",
+    "nul",
+    "{\"a\": 1} x",
+};
+BOOST_DATA_TEST_CASE(shall_not_parse_incorrect_streams, incorrectStreams, arg)
+{
+    JsonParser parser;
+    BOOST_TEST(0 != JsonStream_parse(&parser, arg.c_str(), arg.c_str() + arg.size(), doNothing));
+}
+
+struct MemorySource
+{
+    std::string data;
+    size_t position;
+    size_t chunk;
+};
+
+int readMemory(void* context, char* buffer, int capacity)
+{
+    MemorySource* source = static_cast<MemorySource*>(context);
+    size_t len = std::min({ source->data.size() - source->position, source->chunk, static_cast<size_t>(capacity) });
+    memcpy(buffer, source->data.data() + source->position, len);
+    source->position += len;
+    return static_cast<int>(len);
+}
+
+/* Documents with key and text crossing block boundaries many times. */
+std::string makeStream()
+{
+    std::string stream;
+    for (int i = 0; stream.size() < 3 * JSON_STREAM_BLOCK_SIZE; ++i)
+    {
+        stream += R"^^^({ "id": )^^^" + std::to_string(i) + R"^^^(, "name": "document \" number", "values": [1, 2, 3] })^^^" + (i % 2 ? "\n" : " ");
+    }
+    return stream;
+}
+
+/* Single document spanning many blocks, followed by a small one. */
+std::string makeLargeDocument()
+{
+    std::string document = "[";
+    for (int i = 0; document.size() < 16 * JSON_STREAM_BLOCK_SIZE; ++i)
+    {
+        document += R"^^^({ "id": )^^^" + std::to_string(i) + R"^^^(, "name": "value \" )^^^" + std::to_string(i) + "\" },\n";
+    }
+    return document + "{}]\n{ \"last\": true }";
+}
+
+void parseCompressedAndCompare(const std::string& plain, const std::string& compressed)
+{
+    JsonParser parser;
+    collected.clear();
+    BOOST_TEST_REQUIRE(0 == JsonStream_parse(&parser, plain.c_str(), plain.c_str() + plain.size(), collect));
+    std::vector<JpathToExpectation> fromPlain = collected;
+
+    for (size_t chunk : { size_t(1) << 20, size_t(4093) })
+    {
+        MemorySource source{ compressed, 0, chunk };
+        collected.clear();
+        BOOST_TEST(0 == JsonStream_parseCompressed(&parser, readMemory, &source, collect));
+        BOOST_TEST((fromPlain == collected));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(shall_parse_not_compressed_stream)
+{
+    std::string stream = makeStream();
+    parseCompressedAndCompare(stream, stream);
+}
+
+BOOST_AUTO_TEST_CASE(shall_parse_not_compressed_large_document)
+{
+    std::string stream = makeLargeDocument();
+    parseCompressedAndCompare(stream, stream);
+}
+
+#ifdef JSON_PARSER_WITH_ZLIB
+std::string gzip(const std::string& data, int windowBits = 16 + MAX_WBITS)
+{
+    z_stream stream{};
+    deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, windowBits, 8, Z_DEFAULT_STRATEGY);
+    std::string out(deflateBound(&stream, data.size()), '\0');
+    stream.next_in = (Bytef*)data.data();
+    stream.avail_in = data.size();
+    stream.next_out = (Bytef*)&out[0];
+    stream.avail_out = out.size();
+    deflate(&stream, Z_FINISH);
+    out.resize(stream.total_out);
+    deflateEnd(&stream);
+    return out;
+}
+
+BOOST_AUTO_TEST_CASE(shall_parse_gzip_stream)
+{
+    std::string stream = makeStream();
+    std::string half = stream.substr(0, stream.find('\n') + 1);
+    parseCompressedAndCompare(stream, gzip(stream));
+    parseCompressedAndCompare(half + stream, gzip(half) + gzip(stream));
+}
+
+BOOST_AUTO_TEST_CASE(shall_parse_gzip_large_document)
+{
+    std::string stream = makeLargeDocument();
+    parseCompressedAndCompare(stream, gzip(stream));
+    parseCompressedAndCompare(stream + "\n" + stream, gzip(stream) + gzip("\n" + stream));
+}
+
+BOOST_AUTO_TEST_CASE(shall_not_parse_incorrect_large_document)
+{
+    std::string stream = makeLargeDocument();
+    for (const std::string& compressed : { gzip(stream).substr(0, gzip(stream).size() / 2), gzip(stream + "]" + stream) })
+    {
+        MemorySource source{ compressed, 0, 4096 };
+        JsonParser parser;
+        BOOST_TEST(0 != JsonStream_parseCompressed(&parser, readMemory, &source, doNothing));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(shall_parse_zlib_stream)
+{
+    std::string stream = makeStream();
+    std::string half = stream.substr(0, stream.find('\n') + 1);
+    parseCompressedAndCompare(stream, gzip(stream, MAX_WBITS));
+    parseCompressedAndCompare(half + stream, gzip(half, MAX_WBITS) + gzip(stream, MAX_WBITS));
+}
+
+BOOST_AUTO_TEST_CASE(shall_not_parse_truncated_gzip_stream)
+{
+    std::string compressed = gzip(makeStream());
+    MemorySource source{ compressed.substr(0, compressed.size() / 2), 0, 4096 };
+    JsonParser parser;
+    BOOST_TEST(0 != JsonStream_parseCompressed(&parser, readMemory, &source, doNothing));
+}
+#endif
+
+#ifdef JSON_PARSER_WITH_ZSTD
+BOOST_AUTO_TEST_CASE(shall_parse_zstd_stream)
+{
+    std::string stream = makeStream();
+    std::string compressed(ZSTD_compressBound(stream.size()), '\0');
+    compressed.resize(ZSTD_compress(&compressed[0], compressed.size(), stream.data(), stream.size(), 3));
+    parseCompressedAndCompare(stream, compressed);
+}
+#endif
+
+BOOST_DATA_TEST_CASE(shall_inform_from_incremental_parse_as_from_parse, documentsToTranscode, arg)
+{
+    JsonParser parser;
+    collected.clear();
+    BOOST_TEST(0 == JsonParser_parse(&parser, arg.c_str(), arg.c_str() + arg.size(), collect));
+    std::vector<JpathToExpectation> fromParse = collected;
+
+    JsonIncremental incremental;
+    JsonIncremental_init(&incremental);
+    collected.clear();
+    BOOST_TEST(0 == JsonIncremental_parse(&incremental, arg.c_str(), arg.c_str() + arg.size(), collect));
+    BOOST_TEST(fromParse == collected, boost::test_tools::per_element());
+    JsonIncremental_free(&incremental);
+}
+
+struct IncrementalFixture
+{
+    IncrementalFixture()
+        : document(R"^^^({ "Image": { "Width": 800, "Height": 600, "IDs": [116, 943] }, "Title": "View" })^^^")
+    {
+        JsonIncremental_init(&incremental);
+        BOOST_TEST_REQUIRE(0 == JsonIncremental_parse(&incremental, document.c_str(), document.c_str() + document.size(), doNothing));
+    }
+
+    ~IncrementalFixture()
+    {
+        JsonIncremental_free(&incremental);
+    }
+
+    int edit(const std::string& removed, const std::string& inserted)
+    {
+        size_t position = document.find(removed);
+        BOOST_TEST_REQUIRE(position != std::string::npos);
+        document.replace(position, removed.size(), inserted);
+        collected.clear();
+        return JsonIncremental_update(&incremental, document.c_str(), document.c_str() + document.size(),
+            static_cast<int>(position), static_cast<int>(removed.size()), static_cast<int>(inserted.size()), collect);
+    }
+
+    std::string document;
+    JsonIncremental incremental;
+};
+
+BOOST_FIXTURE_TEST_CASE(shall_inform_only_about_changed_values, IncrementalFixture)
+{
+    BOOST_TEST(0 == edit("800", "1024"));
+    std::vector<JpathToExpectation> expected{
+        { "/Image/Width", "1024" },
+        { "/Image", R"^^^({ "Width": 1024, "Height": 600, "IDs": [116, 943] })^^^" },
+        { "", document },
+    };
+    BOOST_TEST(expected == collected, boost::test_tools::per_element());
+
+    BOOST_TEST(0 == edit("\"View\"", "\"Sea view\""));
+    expected = {
+        { "/Title", "\"Sea view\"" },
+        { "", document },
+    };
+    BOOST_TEST(expected == collected, boost::test_tools::per_element());
+
+    BOOST_TEST(0 == edit("943", "944"));
+    expected = {
+        { "/Image/IDs[1]", "944" },
+        { "/Image/IDs", "[116, 944]" },
+        { "/Image", R"^^^({ "Width": 1024, "Height": 600, "IDs": [116, 944] })^^^" },
+        { "", document },
+    };
+    BOOST_TEST(expected == collected, boost::test_tools::per_element());
+}
+
+BOOST_FIXTURE_TEST_CASE(shall_not_inform_about_white_space_changes, IncrementalFixture)
+{
+    BOOST_TEST(0 == edit("\"Height\": 600", "\"Height\":\n\t600"));
+    BOOST_TEST(0 == collected.size());
+    BOOST_TEST(0 == edit("{ \"Image\"", "{\"Image\""));
+    BOOST_TEST(0 == collected.size());
+}
+
+BOOST_FIXTURE_TEST_CASE(shall_inform_about_shifted_array_elements, IncrementalFixture)
+{
+    BOOST_TEST(0 == edit("[116", "[7, 116"));
+    std::vector<JpathToExpectation> expected{
+        { "/Image/IDs[0]", "7" },
+        { "/Image/IDs[1]", "116" },
+        { "/Image/IDs[2]", "943" },
+        { "/Image/IDs", "[7, 116, 943]" },
+        { "/Image", R"^^^({ "Width": 800, "Height": 600, "IDs": [7, 116, 943] })^^^" },
+        { "", document },
+    };
+    BOOST_TEST(expected == collected, boost::test_tools::per_element());
+}
+
+BOOST_FIXTURE_TEST_CASE(shall_inform_about_parent_of_removed_value, IncrementalFixture)
+{
+    BOOST_TEST(0 == edit("\"Width\": 800, ", ""));
+    std::vector<JpathToExpectation> expected{
+        { "/Image", R"^^^({ "Height": 600, "IDs": [116, 943] })^^^" },
+        { "", document },
+    };
+    BOOST_TEST(expected == collected, boost::test_tools::per_element());
+}
+
+BOOST_FIXTURE_TEST_CASE(shall_scan_whole_document_when_edit_changes_boundaries, IncrementalFixture)
+{
+    BOOST_TEST(0 == edit("943]", "943], \"Tags\": [\"sea\"]"));
+    std::vector<JpathToExpectation> expected{
+        { "/Image/Tags[0]", "\"sea\"" },
+        { "/Image/Tags", "[\"sea\"]" },
+        { "/Image", R"^^^({ "Width": 800, "Height": 600, "IDs": [116, 943], "Tags": ["sea"] })^^^" },
+        { "", document },
+    };
+    BOOST_TEST(expected == collected, boost::test_tools::per_element());
+
+    BOOST_TEST(0 == edit("116, 943", "116], \"Size\": [943"));
+    expected = {
+        { "/Image/IDs", "[116]" },
+        { "/Image/Size[0]", "943" },
+        { "/Image/Size", "[943]" },
+        { "/Image", R"^^^({ "Width": 800, "Height": 600, "IDs": [116], "Size": [943], "Tags": ["sea"] })^^^" },
+        { "", document },
+    };
+    BOOST_TEST(expected == collected, boost::test_tools::per_element());
+}
+
+BOOST_AUTO_TEST_CASE(shall_rescan_document_shorter_than_previous_root_offset)
+{
+    std::string before = "   {}";
+    std::vector<char> after{ '1' };
+    JsonIncremental incremental;
+    JsonIncremental_init(&incremental);
+    BOOST_TEST_REQUIRE(0 == JsonIncremental_parse(&incremental, before.c_str(), before.c_str() + before.size(), doNothing));
+    collected.clear();
+    BOOST_TEST(0 == JsonIncremental_update(&incremental, after.data(), after.data() + after.size(), 0, 5, 1, collect));
+    std::vector<JpathToExpectation> expected{ { "", "1" } };
+    BOOST_TEST(expected == collected, boost::test_tools::per_element());
+    BOOST_TEST(0 != JsonIncremental_update(&incremental, after.data(), after.data() + after.size(), 0, 1, 2, collect));
+    JsonIncremental_free(&incremental);
+}
+
+BOOST_AUTO_TEST_CASE(shall_not_update_when_edit_does_not_match_document_length)
+{
+    std::string before = R"^^^({"a":[1],"bbbbbbbb":2})^^^";
+    std::string text = R"^^^({"a":[12]})^^^";
+    std::vector<char> after(text.begin(), text.end());
+    JsonIncremental incremental;
+    JsonIncremental_init(&incremental);
+    BOOST_TEST_REQUIRE(0 == JsonIncremental_parse(&incremental, before.c_str(), before.c_str() + before.size(), doNothing));
+    BOOST_TEST(0 != JsonIncremental_update(&incremental, after.data(), after.data() + after.size(), 7, 0, 1, doNothing));
+    BOOST_TEST_REQUIRE(0 == JsonIncremental_parse(&incremental, before.c_str(), before.c_str() + before.size(), doNothing));
+    BOOST_TEST(0 != JsonIncremental_update(&incremental, before.c_str(), before.c_str() + before.size(), 20, 4, 4, doNothing));
+    JsonIncremental_free(&incremental);
+}
+
+BOOST_FIXTURE_TEST_CASE(shall_not_update_incorrect_edit, IncrementalFixture)
+{
+    BOOST_TEST(0 != edit("600", "6 0"));
+    BOOST_TEST(0 != edit("6 0", "600"));
+    BOOST_TEST(0 == JsonIncremental_parse(&incremental, document.c_str(), document.c_str() + document.size(), doNothing));
+    BOOST_TEST(0 == edit("600", "601"));
+}
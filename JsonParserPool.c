@@ -0,0 +1,219 @@
+﻿#include "JsonParserPool.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+/* MSVC C compiler has no <stdatomic.h> without /experimental:c11atomics, so Interlocked intrinsics are used there.
+   They are full barriers, which is at least as strong as the orders requested below. */
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+
+typedef volatile __int64 JsonParserPool_AtomicHead;
+typedef volatile long JsonParserPool_AtomicIndex;
+
+static void JsonParserPool_initHead(JsonParserPool_AtomicHead* head, uint64_t value)
+{
+	*head = (__int64)value;
+}
+
+/* Plain 64 bit load is not atomic on x86, compare-exchange with itself is. */
+static uint64_t JsonParserPool_loadHead(JsonParserPool_AtomicHead* head)
+{
+	return (uint64_t)_InterlockedCompareExchange64(head, 0, 0);
+}
+
+static int JsonParserPool_exchangeHead(JsonParserPool_AtomicHead* head, uint64_t* expected, uint64_t desired, int isRelease)
+{
+	(void)isRelease;
+	__int64 previous = _InterlockedCompareExchange64(head, (__int64)desired, (__int64)*expected);
+	if ((uint64_t)previous == *expected)
+	{
+		return 1;
+	}
+	*expected = (uint64_t)previous;
+	return 0;
+}
+
+static void JsonParserPool_storeIndex(JsonParserPool_AtomicIndex* index, int32_t value)
+{
+	*index = value;
+}
+
+static int32_t JsonParserPool_loadIndex(JsonParserPool_AtomicIndex* index)
+{
+	return (int32_t)*index;
+}
+#else
+#include <stdatomic.h>
+
+typedef _Atomic uint64_t JsonParserPool_AtomicHead;
+typedef _Atomic int32_t JsonParserPool_AtomicIndex;
+
+static void JsonParserPool_initHead(JsonParserPool_AtomicHead* head, uint64_t value)
+{
+	atomic_init(head, value);
+}
+
+static uint64_t JsonParserPool_loadHead(JsonParserPool_AtomicHead* head)
+{
+	return atomic_load_explicit(head, memory_order_acquire);
+}
+
+/* Weak compare-exchange, on failure expected is updated with current head. */
+static int JsonParserPool_exchangeHead(JsonParserPool_AtomicHead* head, uint64_t* expected, uint64_t desired, int isRelease)
+{
+	if (isRelease)
+	{
+		return atomic_compare_exchange_weak_explicit(head, expected, desired, memory_order_release, memory_order_relaxed);
+	}
+	return atomic_compare_exchange_weak_explicit(head, expected, desired, memory_order_acquire, memory_order_acquire);
+}
+
+static void JsonParserPool_storeIndex(JsonParserPool_AtomicIndex* index, int32_t value)
+{
+	atomic_store_explicit(index, value, memory_order_relaxed);
+}
+
+static int32_t JsonParserPool_loadIndex(JsonParserPool_AtomicIndex* index)
+{
+	return atomic_load_explicit(index, memory_order_relaxed);
+}
+#endif
+
+#define JSON_PARSER_POOL_CACHE_LINE 64
+
+/* Items are used by different threads. Each one is padded to whole cache lines and the array is aligned to a line,
+   so writes to one parser do not invalidate the line of its neighbour (false sharing). */
+typedef union _JsonParserPoolSlot
+{
+	JsonParserPoolItem item;
+	char lines_[(sizeof(JsonParserPoolItem) + JSON_PARSER_POOL_CACHE_LINE - 1) / JSON_PARSER_POOL_CACHE_LINE * JSON_PARSER_POOL_CACHE_LINE];
+} JsonParserPoolSlot;
+
+/* Windows C runtime has no aligned_alloc, memory from _aligned_malloc has to be released by _aligned_free. */
+static JsonParserPoolSlot* JsonParserPool_allocateSlots(int size)
+{
+	size_t bytes = (size_t)(size ? size : 1) * sizeof(JsonParserPoolSlot);
+#ifdef _WIN32
+	JsonParserPoolSlot* slots = (JsonParserPoolSlot*)_aligned_malloc(bytes, JSON_PARSER_POOL_CACHE_LINE);
+#else
+	JsonParserPoolSlot* slots = (JsonParserPoolSlot*)aligned_alloc(JSON_PARSER_POOL_CACHE_LINE, bytes);
+#endif
+	if (slots)
+	{
+		memset(slots, 0, bytes);
+	}
+	return slots;
+}
+
+static void JsonParserPool_freeSlots(JsonParserPoolSlot* slots)
+{
+#ifdef _WIN32
+	_aligned_free(slots);
+#else
+	free(slots);
+#endif
+}
+
+/* Freelist head keeps index of the first free item + 1 in lower half and change counter in upper half.
+   Counter changes on every push and pop, so compare-exchange fails if head was popped and pushed back meanwhile (ABA). */
+struct _JsonParserPool
+{
+	JsonParserPool_AtomicHead head_;
+	JsonParserPoolSlot* slots_;
+	JsonParserPool_AtomicIndex* next_;
+	int size_;
+};
+
+static uint64_t JsonParserPool_makeHead(uint64_t head, int32_t index)
+{
+	return ((head >> 32) + 1) << 32 | (uint32_t)(index + 1);
+}
+
+/* Touches item memory, so first parse on a worker thread does not page fault. */
+static void JsonParserPool_warmUp(JsonParserPoolItem* item)
+{
+	memset(&item->parser, 0, sizeof(item->parser));
+	if (item->buffer.data)
+	{
+		memset(item->buffer.data, 0, item->buffer.capacity);
+	}
+}
+
+JsonParserPool* JsonParserPool_create(int size, int bufferCapacity)
+{
+	JsonParserPool* pool = (JsonParserPool*)malloc(sizeof(JsonParserPool));
+	if (!pool)
+	{
+		return NULL;
+	}
+	pool->slots_ = JsonParserPool_allocateSlots(size);
+	pool->next_ = (JsonParserPool_AtomicIndex*)calloc(size, sizeof(JsonParserPool_AtomicIndex));
+	pool->size_ = size;
+	if (!pool->slots_ || !pool->next_)
+	{
+		JsonParserPool_destroy(pool);
+		return NULL;
+	}
+
+	for (int i = 0; i < size; ++i)
+	{
+		JsonParserPoolItem* item = &pool->slots_[i].item;
+		JsonBuffer_init(&item->buffer);
+		if (bufferCapacity && !JsonBuffer_reserve(&item->buffer, bufferCapacity))
+		{
+			JsonParserPool_destroy(pool);
+			return NULL;
+		}
+		JsonParserPool_warmUp(item);
+		JsonParserPool_storeIndex(&pool->next_[i], i + 1 < size ? i + 1 : -1);
+	}
+	JsonParserPool_initHead(&pool->head_, size ? JsonParserPool_makeHead(0, 0) : 0);
+	return pool;
+}
+
+void JsonParserPool_destroy(JsonParserPool* pool)
+{
+	if (pool->slots_)
+	{
+		for (int i = 0; i < pool->size_; ++i)
+		{
+			JsonBuffer_free(&pool->slots_[i].item.buffer);
+		}
+	}
+	JsonParserPool_freeSlots(pool->slots_);
+	free((void*)pool->next_);
+	free(pool);
+}
+
+JsonParserPoolItem* JsonParserPool_acquire(JsonParserPool* pool)
+{
+	uint64_t head = JsonParserPool_loadHead(&pool->head_);
+	for (;;)
+	{
+		int32_t index = (int32_t)(uint32_t)head - 1;
+		if (index < 0)
+		{
+			return NULL;
+		}
+		int32_t next = JsonParserPool_loadIndex(&pool->next_[index]);
+		if (JsonParserPool_exchangeHead(&pool->head_, &head, JsonParserPool_makeHead(head, next), 0))
+		{
+			return &pool->slots_[index].item;
+		}
+	}
+}
+
+void JsonParserPool_release(JsonParserPool* pool, JsonParserPoolItem* item)
+{
+	int32_t index = (int32_t)((JsonParserPoolSlot*)item - pool->slots_);
+	uint64_t head = JsonParserPool_loadHead(&pool->head_);
+	do
+	{
+		JsonParserPool_storeIndex(&pool->next_[index], (int32_t)(uint32_t)head - 1);
+	} while (!JsonParserPool_exchangeHead(&pool->head_, &head, JsonParserPool_makeHead(head, index), 1));
+}
@@ -0,0 +1,75 @@
+﻿/**
+* Pool of ready to use JsonParser instances for multithreaded clients.
+*
+* Constrains:
+* \li Acquire and release are lock free (freelist with tagged head), so worker threads never block each other.
+*     C11 atomics are used with GCC and Clang, Interlocked intrinsics with MSVC.
+* \li All memory is allocated by JsonParserPool_create. Acquiring parser does not allocate and does not initialize anything.
+* \li Items are padded to whole 64 byte cache lines, so parsers used by different threads do not share a line.
+* \li Pool does not grow. When all items are in use JsonParserPool_acquire returns NULL.
+*/
+
+#ifndef JSON_PARSER_POOL_H_
+#define JSON_PARSER_POOL_H_
+
+#include "JsonParser.h"
+#include "JsonWriter.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* public interface */
+
+/**
+ * \brief JsonParserPoolItem type definition
+ *
+ * Item handed out by the pool. parser can be passed to JsonParser_parse or JsonCbor_parse. buffer is scratch buffer
+ * reserved up front, e.g. for JsonCbor_parse text or writer output. Content of buffer is not cleared between uses.
+ */
+typedef struct _JsonParserPoolItem
+{
+	JsonParser parser;
+	JsonBuffer buffer;
+} JsonParserPoolItem;
+
+/**
+ * \brief JsonParserPool type definition
+ *
+ * Opaque pool object. It is safe to call JsonParserPool_acquire and JsonParserPool_release from many threads concurrently.
+ */
+typedef struct _JsonParserPool JsonParserPool;
+
+/**
+ * \brief Creates pool with all items and their buffers allocated.
+ *
+ * @param size number of items.
+ * @param bufferCapacity capacity reserved for buffer of each item. Can be 0.
+ * @return pool or NULL if memory could not be allocated.
+ */
+JsonParserPool* JsonParserPool_create(int size, int bufferCapacity);
+
+/**
+ * \brief Destroys pool. All items shall be released before.
+ */
+void JsonParserPool_destroy(JsonParserPool* pool);
+
+/**
+ * \brief Takes item from the pool.
+ *
+ * @return item or NULL if all items are in use.
+ */
+JsonParserPoolItem* JsonParserPool_acquire(JsonParserPool* pool);
+
+/**
+ * \brief Returns item acquired from the same pool.
+ */
+void JsonParserPool_release(JsonParserPool* pool, JsonParserPoolItem* item);
+
+/* end of public interface */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // JSON_PARSER_POOL_H_
@@ -0,0 +1,143 @@
+﻿/**
+* Internal SIMD scanning helpers shared by the parser, writer and other passes.
+*
+* Every helper has a scalar tail and a scalar fallback, so the result does not depend on SSE2 being available.
+*/
+
+#ifndef JSON_SIMD_H_
+#define JSON_SIMD_H_
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define JSON_SIMD_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+static inline int JsonSimd_countTrailingZeros(unsigned int bits)
+{
+#if defined(_MSC_VER)
+	unsigned long index;
+	_BitScanForward(&index, bits);
+	return (int)index;
+#else
+	return __builtin_ctz(bits);
+#endif
+}
+
+static inline int JsonSimd_countTrailingZeros64(unsigned long long bits)
+{
+#if defined(_MSC_VER) && defined(_M_X64)
+	unsigned long index;
+	_BitScanForward64(&index, bits);
+	return (int)index;
+#elif defined(_MSC_VER)
+	return (unsigned int)bits ? JsonSimd_countTrailingZeros((unsigned int)bits) : 32 + JsonSimd_countTrailingZeros((unsigned int)(bits >> 32));
+#else
+	return __builtin_ctzll(bits);
+#endif
+}
+
+static inline int JsonSimd_isEscapable(char c)
+{
+	return c == '\"' || c == '\\' || (unsigned char)c < 0x20;
+}
+
+/**
+ * \brief Finds first character which has to be escaped inside json string.
+ *
+ * @return pointer to first '"', '\\' or control character in [begin, end) or end if there is none.
+ */
+static inline const char* JsonSimd_findEscapable(const char* begin, const char* end)
+{
+#ifdef JSON_SIMD_SSE2
+	const __m128i quote = _mm_set1_epi8('\"');
+	const __m128i backslash = _mm_set1_epi8('\\');
+	const __m128i lastControl = _mm_set1_epi8(0x1F);
+	for (; end - begin >= 16; begin += 16)
+	{
+		__m128i chunk = _mm_loadu_si128((const __m128i*)begin);
+		__m128i mask = _mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, backslash));
+		mask = _mm_or_si128(mask, _mm_cmpeq_epi8(_mm_min_epu8(chunk, lastControl), chunk));
+		unsigned int bits = (unsigned int)_mm_movemask_epi8(mask);
+		if (bits)
+		{
+			return begin + JsonSimd_countTrailingZeros(bits);
+		}
+	}
+#endif
+	for (; begin < end && !JsonSimd_isEscapable(*begin); ++begin)
+	{
+	}
+	return begin;
+}
+
+static inline int JsonSimd_isWhiteSpace(char c)
+{
+	return c == 0x20 || c == 0x09 || c == 0x0A || c == 0x0D;
+}
+
+/**
+ * \brief Skips json white spaces.
+ *
+ * @return pointer to first non white space character in [begin, end) or end if there is none.
+ */
+static inline const char* JsonSimd_skipWhiteSpaces(const char* begin, const char* end)
+{
+	if (begin < end && !JsonSimd_isWhiteSpace(*begin))
+	{
+		return begin;
+	}
+#ifdef JSON_SIMD_SSE2
+	const __m128i space = _mm_set1_epi8(0x20);
+	const __m128i tab = _mm_set1_epi8(0x09);
+	const __m128i lineFeed = _mm_set1_epi8(0x0A);
+	const __m128i carriageReturn = _mm_set1_epi8(0x0D);
+	for (; end - begin >= 16; begin += 16)
+	{
+		__m128i chunk = _mm_loadu_si128((const __m128i*)begin);
+		__m128i mask = _mm_or_si128(_mm_cmpeq_epi8(chunk, space), _mm_cmpeq_epi8(chunk, tab));
+		mask = _mm_or_si128(mask, _mm_or_si128(_mm_cmpeq_epi8(chunk, lineFeed), _mm_cmpeq_epi8(chunk, carriageReturn)));
+		unsigned int bits = ~(unsigned int)_mm_movemask_epi8(mask) & 0xFFFF;
+		if (bits)
+		{
+			return begin + JsonSimd_countTrailingZeros(bits);
+		}
+	}
+#endif
+	for (; begin < end && JsonSimd_isWhiteSpace(*begin); ++begin)
+	{
+	}
+	return begin;
+}
+
+/**
+ * \brief Finds end of plain run inside json string.
+ *
+ * @return pointer to first '"' or '\\' in [begin, end) or end if there is none.
+ */
+static inline const char* JsonSimd_findQuoteOrBackslash(const char* begin, const char* end)
+{
+#ifdef JSON_SIMD_SSE2
+	const __m128i quote = _mm_set1_epi8('\"');
+	const __m128i backslash = _mm_set1_epi8('\\');
+	for (; end - begin >= 16; begin += 16)
+	{
+		__m128i chunk = _mm_loadu_si128((const __m128i*)begin);
+		__m128i mask = _mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, backslash));
+		unsigned int bits = (unsigned int)_mm_movemask_epi8(mask);
+		if (bits)
+		{
+			return begin + JsonSimd_countTrailingZeros(bits);
+		}
+	}
+#endif
+	for (; begin < end && *begin != '\"' && *begin != '\\'; ++begin)
+	{
+	}
+	return begin;
+}
+
+#endif // JSON_SIMD_H_
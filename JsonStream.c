@@ -0,0 +1,619 @@
+﻿#include "JsonStream.h"
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <threads.h>
+
+#include "JsonSimd.h"
+#include "JsonWriter.h"
+
+#ifdef JSON_PARSER_WITH_ZLIB
+#include <zlib.h>
+#endif
+#ifdef JSON_PARSER_WITH_ZSTD
+#include <zstd.h>
+#endif
+
+enum
+{
+	JsonStream_plain,
+	JsonStream_deflate,
+	JsonStream_zstd
+};
+
+/* Finds document boundaries. Offsets are relative to begin of currently scanned data. */
+typedef struct _JsonStreamSplitter
+{
+	ptrdiff_t documentBegin_;
+	ptrdiff_t position_;
+	int depth_;
+	int inString_;
+	int isEscaped_;
+	int inScalar_;
+} JsonStreamSplitter;
+
+typedef struct _JsonStreamSource
+{
+	TReadCallback read_;
+	void* context_;
+	char* input_;
+	int inputLen_;
+	int inputPos_;
+	int isEnd_;
+	int format_;
+	int isFrameOpen_;
+#ifdef JSON_PARSER_WITH_ZLIB
+	z_stream zlib_;
+#endif
+#ifdef JSON_PARSER_WITH_ZSTD
+	ZSTD_DStream* zstd_;
+#endif
+} JsonStreamSource;
+
+enum
+{
+	JsonStreamDirect_none,
+	JsonStreamDirect_offered,
+	JsonStreamDirect_taken,
+	JsonStreamDirect_done
+};
+
+/**
+ * Bounded ring of decompressed blocks. Decompression thread fills blocks after the filled ones, parsing thread consumes from first_.
+ *
+ * Inside a document bigger than a block, parsing thread offers free space at the end of its window (direct_). Decompression
+ * thread then stops filling the ring, waits until it is consumed, so order of data is kept, and decompresses to the offered
+ * space without a copy.
+ * Parsing thread does not move or resize the window while offer is offered or taken.
+ */
+typedef struct _JsonStreamRing
+{
+	mtx_t mutex_;
+	cnd_t changed_;
+	char* blocks_;
+	int lens_[JSON_STREAM_BLOCKS];
+	int first_;
+	int filled_;
+	int isFinished_;
+	int isFailed_;
+	int isCancelled_;
+	char* direct_;
+	int directCapacity_;
+	int directLen_;
+	int directState_;
+	JsonStreamSource* source_;
+} JsonStreamRing;
+
+int JsonStream_readFile(void* context, char* buffer, int capacity)
+{
+	FILE* file = (FILE*)context;
+	size_t len = fread(buffer, 1, capacity, file);
+	if (len == 0 && ferror(file))
+	{
+		return -1;
+	}
+	return (int)len;
+}
+
+static void JsonStreamSplitter_init(JsonStreamSplitter* splitter)
+{
+	splitter->documentBegin_ = -1;
+	splitter->position_ = 0;
+	splitter->depth_ = 0;
+	splitter->inString_ = 0;
+	splitter->isEscaped_ = 0;
+	splitter->inScalar_ = 0;
+}
+
+static int JsonStreamSplitter_isScalarEnd(char c)
+{
+	return JsonSimd_isWhiteSpace(c) || c == '{' || c == '}' || c == '[' || c == ']' || c == ',' || c == ':' || c == '\"';
+}
+
+static int JsonStreamSplitter_parseDocument(JsonStreamSplitter* splitter, JsonParser* parser, const char* begin, TValueInformCallback valueInformCallback)
+{
+	int result = JsonParser_parse(parser, begin + splitter->documentBegin_, begin + splitter->position_, valueInformCallback);
+	splitter->documentBegin_ = -1;
+	return result;
+}
+
+/**
+ * Scans [begin + position_, begin + len) and parses every document completed there.
+ * If isLast is set there is no more data, so document which is not completed is an error.
+ * Returns 0 on success.
+ */
+static int JsonStreamSplitter_split(JsonStreamSplitter* splitter, JsonParser* parser, const char* begin, ptrdiff_t len, int isLast, TValueInformCallback valueInformCallback)
+{
+	while (splitter->position_ < len)
+	{
+		if (splitter->inString_)
+		{
+			if (splitter->isEscaped_)
+			{
+				splitter->isEscaped_ = 0;
+				++splitter->position_;
+				continue;
+			}
+			splitter->position_ = JsonSimd_findQuoteOrBackslash(begin + splitter->position_, begin + len) - begin;
+			if (splitter->position_ == len)
+			{
+				break;
+			}
+			if (begin[splitter->position_++] == '\\')
+			{
+				splitter->isEscaped_ = 1;
+				continue;
+			}
+			splitter->inString_ = 0;
+			if (splitter->depth_ == 0 && JsonStreamSplitter_parseDocument(splitter, parser, begin, valueInformCallback))
+			{
+				return 1;
+			}
+			continue;
+		}
+
+		char c = begin[splitter->position_];
+		if (splitter->inScalar_)
+		{
+			if (!JsonStreamSplitter_isScalarEnd(c))
+			{
+				++splitter->position_;
+				continue;
+			}
+			splitter->inScalar_ = 0;
+			if (JsonStreamSplitter_parseDocument(splitter, parser, begin, valueInformCallback))
+			{
+				return 1;
+			}
+			continue;
+		}
+		if (splitter->documentBegin_ < 0)
+		{
+			splitter->position_ = JsonSimd_skipWhiteSpaces(begin + splitter->position_, begin + len) - begin;
+			if (splitter->position_ == len)
+			{
+				break;
+			}
+			splitter->documentBegin_ = splitter->position_;
+			c = begin[splitter->position_];
+		}
+
+		++splitter->position_;
+		if (c == '\"')
+		{
+			splitter->inString_ = 1;
+			continue;
+		}
+		if (c == '{' || c == '[')
+		{
+			++splitter->depth_;
+			continue;
+		}
+		if (c == '}' || c == ']')
+		{
+			if (--splitter->depth_ < 0)
+			{
+				return 1;
+			}
+			if (splitter->depth_ == 0 && JsonStreamSplitter_parseDocument(splitter, parser, begin, valueInformCallback))
+			{
+				return 1;
+			}
+			continue;
+		}
+		if (splitter->depth_ == 0)
+		{
+			splitter->inScalar_ = 1;
+		}
+	}
+
+	if (!isLast)
+	{
+		return 0;
+	}
+	if (splitter->inScalar_)
+	{
+		splitter->inScalar_ = 0;
+		return JsonStreamSplitter_parseDocument(splitter, parser, begin, valueInformCallback);
+	}
+	return splitter->documentBegin_ >= 0;
+}
+
+int JsonStream_parse(JsonParser* parser, const char* begin, const char* end, TValueInformCallback valueInformCallback)
+{
+	JsonStreamSplitter splitter;
+	JsonStreamSplitter_init(&splitter);
+	return JsonStreamSplitter_split(&splitter, parser, begin, end - begin, 1, valueInformCallback);
+}
+
+/* Makes sure that there is unconsumed input, unless input is over. Returns 0 on read error. */
+static int JsonStreamSource_fillInput(JsonStreamSource* source)
+{
+	if (source->inputPos_ < source->inputLen_ || source->isEnd_)
+	{
+		return 1;
+	}
+	int len = source->read_(source->context_, source->input_, JSON_STREAM_BLOCK_SIZE);
+	if (len < 0)
+	{
+		return 0;
+	}
+	source->inputLen_ = len;
+	source->inputPos_ = 0;
+	source->isEnd_ = len == 0;
+	return 1;
+}
+
+/* Reads until magic bytes can be checked and prepares decompressor. Returns 0 on failure. */
+static int JsonStreamSource_open(JsonStreamSource* source)
+{
+	while (source->inputLen_ < 4 && !source->isEnd_)
+	{
+		int len = source->read_(source->context_, source->input_ + source->inputLen_, JSON_STREAM_BLOCK_SIZE - source->inputLen_);
+		if (len < 0)
+		{
+			return 0;
+		}
+		source->inputLen_ += len;
+		source->isEnd_ = len == 0;
+	}
+
+	const unsigned char* magic = (const unsigned char*)source->input_;
+	source->format_ = JsonStream_plain;
+	if (source->inputLen_ >= 4 && magic[0] == 0x28 && magic[1] == 0xB5 && magic[2] == 0x2F && magic[3] == 0xFD)
+	{
+		source->format_ = JsonStream_zstd;
+	}
+	/* gzip magic or zlib header with deflate and 32K window (check bits make it a multiple of 31). Plain json cannot start with 'x'. */
+	if (source->inputLen_ >= 2 && ((magic[0] == 0x1F && magic[1] == 0x8B) || (magic[0] == 0x78 && (magic[0] * 256 + magic[1]) % 31 == 0)))
+	{
+		source->format_ = JsonStream_deflate;
+	}
+
+	switch (source->format_)
+	{
+	case JsonStream_deflate:
+#ifdef JSON_PARSER_WITH_ZLIB
+		memset(&source->zlib_, 0, sizeof(source->zlib_));
+		return inflateInit2(&source->zlib_, 32 + MAX_WBITS) == Z_OK;
+#else
+		return 0;
+#endif
+	case JsonStream_zstd:
+#ifdef JSON_PARSER_WITH_ZSTD
+		source->zstd_ = ZSTD_createDStream();
+		return source->zstd_ != NULL;
+#else
+		return 0;
+#endif
+	default:
+		return 1;
+	}
+}
+
+static void JsonStreamSource_close(JsonStreamSource* source)
+{
+#ifdef JSON_PARSER_WITH_ZLIB
+	if (source->format_ == JsonStream_deflate)
+	{
+		inflateEnd(&source->zlib_);
+	}
+#endif
+#ifdef JSON_PARSER_WITH_ZSTD
+	if (source->format_ == JsonStream_zstd)
+	{
+		ZSTD_freeDStream(source->zstd_);
+	}
+#endif
+}
+
+/* Decompresses one step into out. Returns number of produced bytes or -1 on error. */
+static int JsonStreamSource_decompress(JsonStreamSource* source, char* out, int capacity)
+{
+	const char* input = source->input_ + source->inputPos_;
+	int inputLen = source->inputLen_ - source->inputPos_;
+	switch (source->format_)
+	{
+#ifdef JSON_PARSER_WITH_ZLIB
+	case JsonStream_deflate:
+	{
+		source->zlib_.next_in = (Bytef*)input;
+		source->zlib_.avail_in = inputLen;
+		source->zlib_.next_out = (Bytef*)out;
+		source->zlib_.avail_out = capacity;
+		int result = inflate(&source->zlib_, Z_NO_FLUSH);
+		source->inputPos_ += inputLen - (int)source->zlib_.avail_in;
+		source->isFrameOpen_ = result != Z_STREAM_END;
+		if (result == Z_STREAM_END)
+		{
+			/* Next gzip member or zlib stream may follow, e.g. for files concatenated or compressed in parallel. */
+			inflateReset(&source->zlib_);
+		}
+		else if (result != Z_OK && result != Z_BUF_ERROR)
+		{
+			return -1;
+		}
+		return capacity - (int)source->zlib_.avail_out;
+	}
+#endif
+#ifdef JSON_PARSER_WITH_ZSTD
+	case JsonStream_zstd:
+	{
+		ZSTD_inBuffer in = { input, (size_t)inputLen, 0 };
+		ZSTD_outBuffer output = { out, (size_t)capacity, 0 };
+		size_t result = ZSTD_decompressStream(source->zstd_, &output, &in);
+		if (ZSTD_isError(result))
+		{
+			return -1;
+		}
+		source->inputPos_ += (int)in.pos;
+		source->isFrameOpen_ = result != 0;
+		return (int)output.pos;
+	}
+#endif
+	default:
+	{
+		int len = inputLen < capacity ? inputLen : capacity;
+		memcpy(out, input, len);
+		source->inputPos_ += len;
+		return len;
+	}
+	}
+}
+
+/* Fills whole block, unless input is over. Returns number of produced bytes, 0 at the end or -1 on error. */
+static int JsonStreamSource_read(JsonStreamSource* source, char* out, int capacity)
+{
+	int produced = 0;
+	while (produced < capacity)
+	{
+		if (!JsonStreamSource_fillInput(source))
+		{
+			return -1;
+		}
+		if (source->inputPos_ == source->inputLen_ && source->isEnd_)
+		{
+			if (source->isFrameOpen_)
+			{
+				return -1;
+			}
+			break;
+		}
+		int len = JsonStreamSource_decompress(source, out + produced, capacity - produced);
+		if (len < 0)
+		{
+			return -1;
+		}
+		produced += len;
+	}
+	return produced;
+}
+
+static int JsonStreamRing_decompress(void* argument)
+{
+	JsonStreamRing* ring = (JsonStreamRing*)argument;
+	for (;;)
+	{
+		mtx_lock(&ring->mutex_);
+		int isDirect = 0;
+		for (;;)
+		{
+			isDirect = ring->directState_ == JsonStreamDirect_offered && ring->filled_ == 0;
+			int isRing = ring->directState_ == JsonStreamDirect_none && ring->filled_ < JSON_STREAM_BLOCKS;
+			if (isDirect || isRing || ring->isCancelled_)
+			{
+				break;
+			}
+			cnd_wait(&ring->changed_, &ring->mutex_);
+		}
+		int slot = (ring->first_ + ring->filled_) % JSON_STREAM_BLOCKS;
+		char* out = ring->blocks_ + (size_t)slot * JSON_STREAM_BLOCK_SIZE;
+		int capacity = JSON_STREAM_BLOCK_SIZE;
+		if (isDirect)
+		{
+			ring->directState_ = JsonStreamDirect_taken;
+			out = ring->direct_;
+			capacity = ring->directCapacity_;
+		}
+		int isCancelled = ring->isCancelled_;
+		mtx_unlock(&ring->mutex_);
+		if (isCancelled)
+		{
+			return 0;
+		}
+
+		int len = JsonStreamSource_read(ring->source_, out, capacity);
+
+		mtx_lock(&ring->mutex_);
+		if (len > 0 && isDirect)
+		{
+			ring->directLen_ = len;
+			ring->directState_ = JsonStreamDirect_done;
+		}
+		else if (len > 0)
+		{
+			ring->lens_[slot] = len;
+			++ring->filled_;
+		}
+		else
+		{
+			ring->directState_ = JsonStreamDirect_none;
+			ring->isFinished_ = 1;
+			ring->isFailed_ = len < 0;
+		}
+		cnd_signal(&ring->changed_);
+		mtx_unlock(&ring->mutex_);
+		if (len <= 0)
+		{
+			return 0;
+		}
+	}
+}
+
+/* Takes back offer which was not taken yet. Returns 1 if window can be changed. */
+static int JsonStream_withdraw(JsonStreamRing* ring)
+{
+	mtx_lock(&ring->mutex_);
+	if (ring->directState_ == JsonStreamDirect_offered)
+	{
+		ring->directState_ = JsonStreamDirect_none;
+		cnd_signal(&ring->changed_);
+	}
+	int isFree = ring->directState_ == JsonStreamDirect_none;
+	mtx_unlock(&ring->mutex_);
+	return isFree;
+}
+
+/* Moves not yet parsed document to the front of the window, unless decompression thread writes after it. */
+static void JsonStream_compact(JsonStreamRing* ring, JsonStreamSplitter* splitter, JsonBuffer* window)
+{
+	ptrdiff_t keep = splitter->documentBegin_ >= 0 ? splitter->documentBegin_ : splitter->position_;
+	if (keep == 0 || !JsonStream_withdraw(ring))
+	{
+		return;
+	}
+	memmove(window->data, window->data + keep, window->len - keep);
+	window->len -= (int)keep;
+	splitter->position_ -= keep;
+	if (splitter->documentBegin_ >= 0)
+	{
+		splitter->documentBegin_ -= keep;
+	}
+}
+
+static int JsonStream_consume(JsonStreamRing* ring, JsonParser* parser, TValueInformCallback valueInformCallback)
+{
+	JsonStreamSplitter splitter;
+	JsonStreamSplitter_init(&splitter);
+	JsonBuffer window;
+	JsonBuffer_init(&window);
+	int result = 0;
+
+	for (;;)
+	{
+		mtx_lock(&ring->mutex_);
+		while (ring->filled_ == 0 && ring->directState_ != JsonStreamDirect_done && !ring->isFinished_)
+		{
+			cnd_wait(&ring->changed_, &ring->mutex_);
+		}
+		int slot = ring->first_;
+		int isDirect = ring->directState_ == JsonStreamDirect_done;
+		int isEmpty = !isDirect && ring->filled_ == 0;
+		int directLen = ring->directLen_;
+		result = ring->isFailed_;
+		mtx_unlock(&ring->mutex_);
+		if (isEmpty)
+		{
+			break;
+		}
+
+		/* Offer is not taken while the ring is not empty, so window can be changed until the block is popped below. */
+		int previousLen = window.len;
+		if (isDirect)
+		{
+			window.len += directLen;
+		}
+		else if (!JsonBuffer_append(&window, ring->blocks_ + (size_t)slot * JSON_STREAM_BLOCK_SIZE, ring->lens_[slot]))
+		{
+			result = 1;
+			break;
+		}
+
+		/* Document which was open before this block and already bigger than a block is likely to continue.
+		   Next block is decompressed into the window while this one is scanned. */
+		int isLarge = splitter.documentBegin_ >= 0 && previousLen - splitter.documentBegin_ >= JSON_STREAM_BLOCK_SIZE;
+		if (isLarge && !JsonBuffer_reserve(&window, JSON_STREAM_BLOCK_SIZE))
+		{
+			result = 1;
+			break;
+		}
+		int capacity = window.capacity - window.len;
+		mtx_lock(&ring->mutex_);
+		if (!isDirect)
+		{
+			ring->first_ = (ring->first_ + 1) % JSON_STREAM_BLOCKS;
+			--ring->filled_;
+		}
+		ring->directState_ = isLarge ? JsonStreamDirect_offered : JsonStreamDirect_none;
+		ring->direct_ = window.data + window.len;
+		ring->directCapacity_ = capacity < JSON_STREAM_BLOCKS * JSON_STREAM_BLOCK_SIZE ? capacity : JSON_STREAM_BLOCKS * JSON_STREAM_BLOCK_SIZE;
+		cnd_signal(&ring->changed_);
+		mtx_unlock(&ring->mutex_);
+
+		result = JsonStreamSplitter_split(&splitter, parser, window.data, window.len, 0, valueInformCallback);
+		if (result)
+		{
+			break;
+		}
+		JsonStream_compact(ring, &splitter, &window);
+	}
+
+	/* Decompression thread may still write to the window. */
+	mtx_lock(&ring->mutex_);
+	if (ring->directState_ == JsonStreamDirect_offered)
+	{
+		ring->directState_ = JsonStreamDirect_none;
+	}
+	while (ring->directState_ == JsonStreamDirect_taken)
+	{
+		cnd_wait(&ring->changed_, &ring->mutex_);
+	}
+	mtx_unlock(&ring->mutex_);
+
+	if (!result)
+	{
+		result = JsonStreamSplitter_split(&splitter, parser, window.data, window.len, 1, valueInformCallback);
+	}
+	JsonBuffer_free(&window);
+	return result;
+}
+
+int JsonStream_parseCompressed(JsonParser* parser, TReadCallback read, void* context, TValueInformCallback valueInformCallback)
+{
+	JsonStreamSource source;
+	memset(&source, 0, sizeof(source));
+	source.read_ = read;
+	source.context_ = context;
+	source.input_ = (char*)malloc(JSON_STREAM_BLOCK_SIZE);
+	if (!source.input_)
+	{
+		return 1;
+	}
+	if (!JsonStreamSource_open(&source))
+	{
+		free(source.input_);
+		return 1;
+	}
+
+	JsonStreamRing ring;
+	memset(&ring, 0, sizeof(ring));
+	ring.source_ = &source;
+	ring.blocks_ = (char*)malloc((size_t)JSON_STREAM_BLOCKS * JSON_STREAM_BLOCK_SIZE);
+	thrd_t decompressor;
+	int result = 1;
+	if (ring.blocks_ && mtx_init(&ring.mutex_, mtx_plain) == thrd_success)
+	{
+		if (cnd_init(&ring.changed_) == thrd_success)
+		{
+			if (thrd_create(&decompressor, JsonStreamRing_decompress, &ring) == thrd_success)
+			{
+				result = JsonStream_consume(&ring, parser, valueInformCallback);
+
+				mtx_lock(&ring.mutex_);
+				ring.isCancelled_ = 1;
+				cnd_signal(&ring.changed_);
+				mtx_unlock(&ring.mutex_);
+				thrd_join(decompressor, NULL);
+			}
+			cnd_destroy(&ring.changed_);
+		}
+		mtx_destroy(&ring.mutex_);
+	}
+
+	free(ring.blocks_);
+	JsonStreamSource_close(&source);
+	free(source.input_);
+	return result;
+}
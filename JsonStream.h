@@ -0,0 +1,74 @@
+﻿/**
+* Parsing of json streams: documents separated by white spaces (e.g. json lines or concatenated documents),
+* optionally gzip, zlib or zstd compressed.
+*
+* Constrains:
+* \li Each document is parsed by JsonParser_parse, so callbacks are called exactly as for a single document, once per document.
+* \li Compressed input is decompressed in JSON_STREAM_BLOCK_SIZE blocks by a worker thread, while documents are parsed on the calling thread.
+*     Memory use is JSON_STREAM_BLOCKS blocks plus the biggest document, instead of the whole inflated stream.
+* \li Single document is still parsed in place, so it has to fit in memory. Document bigger than a block is decompressed directly
+*     into the buffer it is parsed from, which grows by doubling, so it can take up to twice the document size. Its parsing
+*     starts when it is complete, only decompression overlaps with scanning for its end.
+* \li Document size is limited to INT_MAX bytes (2 GiB - 1). Stream with bigger document fails, total stream size is not limited.
+* \li Worker thread uses C11 <threads.h>, which MSVC provides since Visual Studio 2022 17.8 with /std:c11.
+*/
+
+#ifndef JSON_STREAM_H_
+#define JSON_STREAM_H_
+
+#include "JsonParser.h"
+
+/* definitions */
+#define JSON_STREAM_BLOCK_SIZE (256 * 1024)
+#define JSON_STREAM_BLOCKS 4
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* public interface */
+
+/**
+ * \brief TReadCallback definition.
+ *
+ * Source of compressed input. It is called from decompression thread.
+ *
+ * @param context context passed to JsonStream_parseCompressed.
+ * @param buffer buffer to read to.
+ * @param capacity size of the buffer.
+ * @return number of bytes read, 0 at the end of input, -1 on error.
+ */
+typedef int (*TReadCallback)(void* context, char* buffer, int capacity);
+
+/**
+ * \brief TReadCallback reading from FILE*, which shall be passed as context.
+ */
+int JsonStream_readFile(void* context, char* buffer, int capacity);
+
+/**
+ * \brief Parses all documents from [begin, end).
+ *
+ * @return 0 if every document was parsed successfully. Parsing stops at first incorrect document.
+ */
+int JsonStream_parse(JsonParser* parser, const char* begin, const char* end, TValueInformCallback valueInformCallback);
+
+/**
+ * \brief Decompresses input on a worker thread and parses all documents on the calling thread.
+ *
+ * Format is recognized by magic bytes: zstd frame, gzip or zlib stream. Other input is treated as not compressed.
+ *
+ * @param parser parser instance.
+ * @param read source of input.
+ * @param context passed to read.
+ * @param valueInformCallback see TValueInformCallback.
+ * @return 0 if input was decompressed and every document was parsed successfully.
+ */
+int JsonStream_parseCompressed(JsonParser* parser, TReadCallback read, void* context, TValueInformCallback valueInformCallback);
+
+/* end of public interface */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // JSON_STREAM_H_
@@ -0,0 +1,78 @@
+﻿/* Compares inflate-then-parse with pipelined JsonStream_parseCompressed on gzip compressed json stream.
+   Usage: JsonStreamBenchmark inflate|pipeline <file.gz>
+   Each mode is run in separate process, so peak memory can be measured externally (e.g. /usr/bin/time -v).
+   Run it for json lines and for a single large document (e.g. one array of records), they take different paths. */
+
+#include "JsonStream.h"
+
+#include <zlib.h>
+
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <string>
+
+long long informedValues = 0;
+
+void countValues(const char* key, int keyLen, const char* value, int valueLen)
+{
+    ++informedValues;
+}
+
+int inflateThenParse(const char* path, long long& inflatedSize)
+{
+    gzFile file = gzopen(path, "rb");
+    if (!file)
+    {
+        return 1;
+    }
+    gzbuffer(file, JSON_STREAM_BLOCK_SIZE);
+
+    std::string inflated;
+    std::string block(JSON_STREAM_BLOCK_SIZE, '\0');
+    for (int len; (len = gzread(file, &block[0], JSON_STREAM_BLOCK_SIZE)) > 0;)
+    {
+        inflated.append(block.data(), len);
+    }
+    gzclose(file);
+    inflatedSize = inflated.size();
+
+    JsonParser parser;
+    return JsonStream_parse(&parser, inflated.data(), inflated.data() + inflated.size(), countValues);
+}
+
+int pipeline(const char* path)
+{
+    FILE* file = fopen(path, "rb");
+    if (!file)
+    {
+        return 1;
+    }
+    JsonParser parser;
+    int result = JsonStream_parseCompressed(&parser, JsonStream_readFile, file, countValues);
+    fclose(file);
+    return result;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc != 3)
+    {
+        std::cerr << "Usage: " << argv[0] << " inflate|pipeline <file.gz>" << std::endl;
+        return 2;
+    }
+    std::string mode = argv[1];
+
+    auto begin = std::chrono::steady_clock::now();
+    long long inflatedSize = 0;
+    int result = mode == "inflate" ? inflateThenParse(argv[2], inflatedSize) : pipeline(argv[2]);
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - begin;
+
+    std::cout << mode << ": result " << result << ", values " << informedValues << ", " << elapsed.count() << " s";
+    if (inflatedSize)
+    {
+        std::cout << ", inflated " << inflatedSize / (1024 * 1024) << " MiB, " << inflatedSize / elapsed.count() / (1024 * 1024) << " MiB/s";
+    }
+    std::cout << std::endl;
+    return result;
+}
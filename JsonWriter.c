@@ -0,0 +1,511 @@
+﻿#include "JsonWriter.h"
+
+#include <limits.h>
+#include <math.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "JsonSimd.h"
+#include "JsonPow10.h"
+
+static const char JsonWriter_digitPairs[201] =
+	"00010203040506070809"
+	"10111213141516171819"
+	"20212223242526272829"
+	"30313233343536373839"
+	"40414243444546474849"
+	"50515253545556575859"
+	"60616263646566676869"
+	"70717273747576777879"
+	"80818283848586878889"
+	"90919293949596979899";
+
+void JsonBuffer_init(JsonBuffer* buffer)
+{
+	buffer->data = NULL;
+	buffer->len = 0;
+	buffer->capacity = 0;
+}
+
+void JsonBuffer_free(JsonBuffer* buffer)
+{
+	free(buffer->data);
+	JsonBuffer_init(buffer);
+}
+
+void JsonBuffer_clear(JsonBuffer* buffer)
+{
+	buffer->len = 0;
+}
+
+int JsonBuffer_reserve(JsonBuffer* buffer, int additional)
+{
+	if (buffer->capacity - buffer->len >= additional)
+	{
+		return 1;
+	}
+	if (additional < 0 || additional > INT_MAX - buffer->len)
+	{
+		return 0;
+	}
+	int capacity = buffer->capacity ? buffer->capacity : 64;
+	while (capacity - buffer->len < additional)
+	{
+		capacity = capacity > INT_MAX / 2 ? INT_MAX : capacity * 2;
+	}
+	char* data = (char*)realloc(buffer->data, capacity);
+	if (!data)
+	{
+		return 0;
+	}
+	buffer->data = data;
+	buffer->capacity = capacity;
+	return 1;
+}
+
+int JsonBuffer_append(JsonBuffer* buffer, const char* begin, int len)
+{
+	if (!JsonBuffer_reserve(buffer, len))
+	{
+		return 0;
+	}
+	memcpy(buffer->data + buffer->len, begin, len);
+	buffer->len += len;
+	return 1;
+}
+
+int JsonWriter_formatInt(char* out, long long value)
+{
+	char digits[20];
+	char* it = digits + sizeof(digits);
+	unsigned long long magnitude = value < 0 ? 0ull - (unsigned long long)value : (unsigned long long)value;
+
+	while (magnitude >= 100)
+	{
+		it -= 2;
+		memcpy(it, JsonWriter_digitPairs + (magnitude % 100) * 2, 2);
+		magnitude /= 100;
+	}
+	if (magnitude >= 10)
+	{
+		it -= 2;
+		memcpy(it, JsonWriter_digitPairs + magnitude * 2, 2);
+	}
+	else
+	{
+		*--it = (char)('0' + magnitude);
+	}
+	if (value < 0)
+	{
+		*--it = '-';
+	}
+
+	int len = (int)(digits + sizeof(digits) - it);
+	memcpy(out, it, len);
+	return len;
+}
+
+void JsonWriter_init(JsonWriter* writer, JsonBuffer* buffer)
+{
+	writer->buffer_ = buffer;
+	writer->containers_[0] = 0;
+	writer->hasElements_[0] = 0;
+	writer->depth_ = 0;
+	writer->afterKey_ = 0;
+	writer->isInvalid = 0;
+}
+
+static void JsonWriter_appendChar(JsonWriter* writer, char c)
+{
+	if (!JsonBuffer_reserve(writer->buffer_, 1))
+	{
+		writer->isInvalid = 1;
+		return;
+	}
+	writer->buffer_->data[writer->buffer_->len++] = c;
+}
+
+static void JsonWriter_append(JsonWriter* writer, const char* begin, int len)
+{
+	if (!JsonBuffer_append(writer->buffer_, begin, len))
+	{
+		writer->isInvalid = 1;
+	}
+}
+
+/* Emits separator required before next value. Returns 0 if value is not allowed in current place. */
+static int JsonWriter_beforeValue(JsonWriter* writer)
+{
+	if (writer->isInvalid)
+	{
+		return 0;
+	}
+	if (writer->afterKey_)
+	{
+		writer->afterKey_ = 0;
+		return 1;
+	}
+	if (writer->depth_ == 0 && writer->hasElements_[0])
+	{
+		writer->isInvalid = 1;
+		return 0;
+	}
+	if (writer->containers_[writer->depth_] == '{')
+	{
+		writer->isInvalid = 1;
+		return 0;
+	}
+	if (writer->hasElements_[writer->depth_])
+	{
+		JsonWriter_appendChar(writer, ',');
+	}
+	writer->hasElements_[writer->depth_] = 1;
+	return !writer->isInvalid;
+}
+
+static void JsonWriter_appendEscaped(JsonWriter* writer, const char* begin, int len)
+{
+	static const char hex[] = "0123456789abcdef";
+	const char* end = begin + len;
+
+	JsonWriter_appendChar(writer, '\"');
+	while (begin < end && !writer->isInvalid)
+	{
+		const char* special = JsonSimd_findEscapable(begin, end);
+		JsonWriter_append(writer, begin, (int)(special - begin));
+		if (special == end)
+		{
+			break;
+		}
+
+		char escaped[6] = { '\\', 0, 0, 0, 0, 0 };
+		int escapedLen = 2;
+		switch (*special)
+		{
+		case '\"': escaped[1] = '\"'; break;
+		case '\\': escaped[1] = '\\'; break;
+		case '\b': escaped[1] = 'b'; break;
+		case '\f': escaped[1] = 'f'; break;
+		case '\n': escaped[1] = 'n'; break;
+		case '\r': escaped[1] = 'r'; break;
+		case '\t': escaped[1] = 't'; break;
+		default:
+			escaped[1] = 'u';
+			escaped[2] = '0';
+			escaped[3] = '0';
+			escaped[4] = hex[(unsigned char)*special >> 4];
+			escaped[5] = hex[(unsigned char)*special & 0x0F];
+			escapedLen = 6;
+		}
+		JsonWriter_append(writer, escaped, escapedLen);
+		begin = special + 1;
+	}
+	JsonWriter_appendChar(writer, '\"');
+}
+
+static void JsonWriter_beginContainer(JsonWriter* writer, char open)
+{
+	if (!JsonWriter_beforeValue(writer))
+	{
+		return;
+	}
+	if (writer->depth_ >= MAX_DEPTH)
+	{
+		writer->isInvalid = 1;
+		return;
+	}
+	JsonWriter_appendChar(writer, open);
+	++writer->depth_;
+	writer->containers_[writer->depth_] = open;
+	writer->hasElements_[writer->depth_] = 0;
+}
+
+static void JsonWriter_endContainer(JsonWriter* writer, char open, char close)
+{
+	if (writer->isInvalid || writer->afterKey_ || writer->depth_ == 0 || writer->containers_[writer->depth_] != open)
+	{
+		writer->isInvalid = 1;
+		return;
+	}
+	JsonWriter_appendChar(writer, close);
+	--writer->depth_;
+}
+
+void JsonWriter_beginObject(JsonWriter* writer)
+{
+	JsonWriter_beginContainer(writer, '{');
+}
+
+void JsonWriter_endObject(JsonWriter* writer)
+{
+	JsonWriter_endContainer(writer, '{', '}');
+}
+
+void JsonWriter_beginArray(JsonWriter* writer)
+{
+	JsonWriter_beginContainer(writer, '[');
+}
+
+void JsonWriter_endArray(JsonWriter* writer)
+{
+	JsonWriter_endContainer(writer, '[', ']');
+}
+
+void JsonWriter_key(JsonWriter* writer, const char* key, int keyLen)
+{
+	if (writer->isInvalid || writer->afterKey_ || writer->containers_[writer->depth_] != '{')
+	{
+		writer->isInvalid = 1;
+		return;
+	}
+	if (writer->hasElements_[writer->depth_])
+	{
+		JsonWriter_appendChar(writer, ',');
+	}
+	writer->hasElements_[writer->depth_] = 1;
+	JsonWriter_appendEscaped(writer, key, keyLen);
+	JsonWriter_appendChar(writer, ':');
+	writer->afterKey_ = 1;
+}
+
+void JsonWriter_string(JsonWriter* writer, const char* value, int valueLen)
+{
+	if (!JsonWriter_beforeValue(writer))
+	{
+		return;
+	}
+	JsonWriter_appendEscaped(writer, value, valueLen);
+}
+
+void JsonWriter_int(JsonWriter* writer, long long value)
+{
+	if (!JsonWriter_beforeValue(writer))
+	{
+		return;
+	}
+	if (!JsonBuffer_reserve(writer->buffer_, 20))
+	{
+		writer->isInvalid = 1;
+		return;
+	}
+	writer->buffer_->len += JsonWriter_formatInt(writer->buffer_->data + writer->buffer_->len, value);
+}
+
+/* High 64 bits of 128 bit product and low 64 bits in *low. */
+static unsigned long long JsonWriter_multiply(unsigned long long lhs, unsigned long long rhs, unsigned long long* low)
+{
+#if defined(__SIZEOF_INT128__)
+	unsigned __int128 product = (unsigned __int128)lhs * rhs;
+	*low = (unsigned long long)product;
+	return (unsigned long long)(product >> 64);
+#else
+	unsigned long long lhsLow = lhs & 0xFFFFFFFFull, lhsHigh = lhs >> 32;
+	unsigned long long rhsLow = rhs & 0xFFFFFFFFull, rhsHigh = rhs >> 32;
+	unsigned long long lowLow = lhsLow * rhsLow;
+	unsigned long long highLow = lhsHigh * rhsLow;
+	unsigned long long lowHigh = lhsLow * rhsHigh;
+	unsigned long long middle = (lowLow >> 32) + (highLow & 0xFFFFFFFFull) + (lowHigh & 0xFFFFFFFFull);
+	*low = (middle << 32) | (lowLow & 0xFFFFFFFFull);
+	return lhsHigh * rhsHigh + (highLow >> 32) + (lowHigh >> 32) + (middle >> 32);
+#endif
+}
+
+/* floor(significand * cp / 2^128), with lowest bit set if the result is not exact. */
+static unsigned long long JsonWriter_roundToOdd(const unsigned long long significand[2], unsigned long long cp)
+{
+	unsigned long long lowLow;
+	unsigned long long lowHigh = JsonWriter_multiply(significand[1], cp, &lowLow);
+	unsigned long long highLow;
+	unsigned long long highHigh = JsonWriter_multiply(significand[0], cp, &highLow);
+	unsigned long long middle = highLow + lowHigh;
+	highHigh += middle < highLow;
+	return highHigh | (middle > 1);
+}
+
+/**
+ * Schubfach (R. Giulietti, "The Schubfach way to render doubles"). Finds the shortest decimal digits * 10^exponent
+ * which reads back to finite, positive value. When there are several, the closest one is chosen.
+ */
+static unsigned long long JsonWriter_toDecimal(double value, int* exponent)
+{
+	unsigned long long bits;
+	memcpy(&bits, &value, sizeof(bits));
+	unsigned long long fraction = bits & ((1ull << 52) - 1);
+	int biasedExponent = (int)((bits >> 52) & 0x7FF);
+
+	unsigned long long c;
+	int q;
+	if (biasedExponent != 0)
+	{
+		c = fraction | (1ull << 52);
+		q = biasedExponent - 1075;
+		if (q <= 0 && q > -53 && (c & ((1ull << -q) - 1)) == 0)
+		{
+			*exponent = 0;
+			return c >> -q;
+		}
+	}
+	else
+	{
+		c = fraction;
+		q = -1074;
+	}
+
+	int isEven = (c & 1) == 0;
+	int isLowerCloser = fraction == 0 && biasedExponent > 1;
+	unsigned long long cbl = 4 * c - 2 + isLowerCloser;
+	unsigned long long cb = 4 * c;
+	unsigned long long cbr = 4 * c + 2;
+
+	/* k = floor(log10(2^q)) or floor(log10(3/4 * 2^q)) when lower boundary is closer. */
+	int k = (q * 1262611 - (isLowerCloser ? 524031 : 0)) >> 22;
+	int h = q + ((-k * 1741647) >> 19) + 1;
+	const unsigned long long* significand = JsonPow10_significands[-k - JSON_POW10_MIN];
+	unsigned long long vbl = JsonWriter_roundToOdd(significand, cbl << h);
+	unsigned long long vb = JsonWriter_roundToOdd(significand, cb << h);
+	unsigned long long vbr = JsonWriter_roundToOdd(significand, cbr << h);
+	unsigned long long lower = vbl + !isEven;
+	unsigned long long upper = vbr - !isEven;
+
+	unsigned long long s = vb / 4;
+	if (s >= 10)
+	{
+		unsigned long long sp = s / 10;
+		int isUpInside = lower <= 40 * sp;
+		int isWpInside = 40 * sp + 40 <= upper;
+		if (isUpInside != isWpInside)
+		{
+			*exponent = k + 1;
+			return sp + isWpInside;
+		}
+	}
+
+	int isUInside = lower <= 4 * s;
+	int isWInside = 4 * s + 4 <= upper;
+	*exponent = k;
+	if (isUInside != isWInside)
+	{
+		return s + isWInside;
+	}
+	unsigned long long middle = 4 * s + 2;
+	return s + (vb > middle || (vb == middle && (s & 1) != 0));
+}
+
+/* Writes digits * 10^exponent in fixed notation for exponents from 1e-5 to 1e15 and in scientific one otherwise. */
+static int JsonWriter_formatDouble(char* out, double value)
+{
+	char* it = out;
+	if (signbit(value))
+	{
+		*it++ = '-';
+		value = -value;
+	}
+	if (value == 0)
+	{
+		*it++ = '0';
+		return (int)(it - out);
+	}
+
+	int exponent;
+	unsigned long long decimal = JsonWriter_toDecimal(value, &exponent);
+	for (; decimal % 10 == 0; decimal /= 10)
+	{
+		++exponent;
+	}
+	char digits[20];
+	int nDigits = JsonWriter_formatInt(digits, (long long)decimal);
+	int pointPosition = nDigits + exponent;
+
+	if (pointPosition > 16 || pointPosition < -4)
+	{
+		*it++ = digits[0];
+		if (nDigits > 1)
+		{
+			*it++ = '.';
+			memcpy(it, digits + 1, nDigits - 1);
+			it += nDigits - 1;
+		}
+		*it++ = 'e';
+		*it++ = pointPosition - 1 < 0 ? '-' : '+';
+		int scientificExponent = pointPosition - 1 < 0 ? 1 - pointPosition : pointPosition - 1;
+		return (int)(it - out) + JsonWriter_formatInt(it, scientificExponent);
+	}
+	if (pointPosition <= 0)
+	{
+		*it++ = '0';
+		*it++ = '.';
+		memset(it, '0', -pointPosition);
+		it += -pointPosition;
+		memcpy(it, digits, nDigits);
+		return (int)(it - out) + nDigits;
+	}
+	if (pointPosition >= nDigits)
+	{
+		memcpy(it, digits, nDigits);
+		memset(it + nDigits, '0', pointPosition - nDigits);
+		return (int)(it - out) + pointPosition;
+	}
+	memcpy(it, digits, pointPosition);
+	it[pointPosition] = '.';
+	memcpy(it + pointPosition + 1, digits + pointPosition, nDigits - pointPosition);
+	return (int)(it - out) + nDigits + 1;
+}
+
+void JsonWriter_double(JsonWriter* writer, double value)
+{
+	if (!isfinite(value))
+	{
+		writer->isInvalid = 1;
+		return;
+	}
+	if (!JsonWriter_beforeValue(writer))
+	{
+		return;
+	}
+	if (!JsonBuffer_reserve(writer->buffer_, 32))
+	{
+		writer->isInvalid = 1;
+		return;
+	}
+	writer->buffer_->len += JsonWriter_formatDouble(writer->buffer_->data + writer->buffer_->len, value);
+}
+
+void JsonWriter_bool(JsonWriter* writer, int value)
+{
+	if (!JsonWriter_beforeValue(writer))
+	{
+		return;
+	}
+	if (value)
+	{
+		JsonWriter_append(writer, "true", 4);
+		return;
+	}
+	JsonWriter_append(writer, "false", 5);
+}
+
+void JsonWriter_null(JsonWriter* writer)
+{
+	if (!JsonWriter_beforeValue(writer))
+	{
+		return;
+	}
+	JsonWriter_append(writer, "null", 4);
+}
+
+void JsonWriter_rawValue(JsonWriter* writer, const char* value, int valueLen)
+{
+	if (!JsonWriter_beforeValue(writer))
+	{
+		return;
+	}
+	JsonWriter_append(writer, value, valueLen);
+}
+
+int JsonWriter_finish(JsonWriter* writer)
+{
+	return writer->isInvalid
+		|| writer->depth_ != 0
+		|| writer->afterKey_
+		|| !writer->hasElements_[0];
+}
@@ -0,0 +1,142 @@
+﻿/**
+* Json writer. Companion of JsonParser, produces compact json (no insignificant white spaces).
+*
+* Constrains:
+* \li Output is appended to caller owned JsonBuffer. Buffer grows geometrically, so there is no allocation per token.
+* \li Strings are expected to be UTF-8. Only '"', '\\' and control characters are escaped.
+* \li Raw values are copied verbatim, so value spans reported by TValueInformCallback can be passed through without reformatting.
+*/
+
+#ifndef JSON_WRITER_H_
+#define JSON_WRITER_H_
+
+#include "JsonParser.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* public interface */
+
+/**
+ * \brief JsonBuffer type definition
+ *
+ * Growable output buffer. Client owns it and may reuse it for many documents (see JsonBuffer_clear), so after warm up no allocation is made at all.
+ * data is not null terminated, len bytes of it are valid.
+ */
+typedef struct _JsonBuffer
+{
+	char* data;
+	int len;
+	int capacity;
+} JsonBuffer;
+
+void JsonBuffer_init(JsonBuffer* buffer);
+void JsonBuffer_free(JsonBuffer* buffer);
+void JsonBuffer_clear(JsonBuffer* buffer);
+
+/**
+ * \brief Makes sure that at least additional bytes can be appended without reallocation.
+ *
+ * @return 1 on success, 0 if memory could not be allocated or buffer would exceed INT_MAX bytes.
+ */
+int JsonBuffer_reserve(JsonBuffer* buffer, int additional);
+
+/**
+ * \brief Appends bytes as they are. Useful to copy untouched parts of a document around a patched value.
+ *
+ * @return 1 on success, 0 if memory could not be allocated.
+ */
+int JsonBuffer_append(JsonBuffer* buffer, const char* begin, int len);
+
+/**
+ * \brief JsonWriter type definition
+ *
+ * JsonWriter writes exactly one json value (usually object or array) to the buffer. Commas and colons are inserted by the writer.
+ * Writer appends, so it is possible to write a document prefix with JsonBuffer_append, then a single value with the writer and then a suffix.
+ * Together with TValueInformCallback spans it allows to patch one field of a large document with two memcpy calls:
+ *
+ *     JsonBuffer_append(&buffer, jsonBegin, value - jsonBegin);
+ *     JsonWriter_init(&writer, &buffer);
+ *     JsonWriter_int(&writer, 42);
+ *     JsonBuffer_append(&buffer, value + valueLen, jsonEnd - (value + valueLen));
+ */
+typedef struct _JsonWriter JsonWriter;
+
+void JsonWriter_init(JsonWriter* writer, JsonBuffer* buffer);
+void JsonWriter_beginObject(JsonWriter* writer);
+void JsonWriter_endObject(JsonWriter* writer);
+void JsonWriter_beginArray(JsonWriter* writer);
+void JsonWriter_endArray(JsonWriter* writer);
+
+/**
+ * \brief Writes object key. Next call shall write the value.
+ *
+ * @param key begin of the key, not escaped, without quotes.
+ * @param keyLen Lenght of the key.
+ */
+void JsonWriter_key(JsonWriter* writer, const char* key, int keyLen);
+
+/**
+ * \brief Writes string value. Characters which need it are escaped.
+ *
+ * @param value begin of the string, not escaped, without quotes.
+ * @param valueLen Lenght of the string.
+ */
+void JsonWriter_string(JsonWriter* writer, const char* value, int valueLen);
+void JsonWriter_int(JsonWriter* writer, long long value);
+
+/**
+ * \brief Writes double in the shortest form which reads back to the same value. NaN and infinities are not allowed in json and make writer invalid.
+ *
+ * Digits are found with Schubfach algorithm, without printf or locale. Values from 1e-5 to below 1e16 are written in fixed notation,
+ * others in scientific one (e.g. 5e-324, 1e+300).
+ */
+void JsonWriter_double(JsonWriter* writer, double value);
+void JsonWriter_bool(JsonWriter* writer, int value);
+void JsonWriter_null(JsonWriter* writer);
+
+/**
+ * \brief Writes already serialized json value verbatim, e.g. value span received in TValueInformCallback.
+ *
+ * @param value begin of json value (string with quotes, number, literal, object or array).
+ * @param valueLen Lenght of the value.
+ */
+void JsonWriter_rawValue(JsonWriter* writer, const char* value, int valueLen);
+
+/**
+ * \brief Checks if written document is complete.
+ *
+ * @return 0 if exactly one value was written, all containers are closed and no error occured.
+ */
+int JsonWriter_finish(JsonWriter* writer);
+
+/**
+ * \brief Formats integer in decimal form.
+ *
+ * @param out at least 20 bytes long output. It is not null terminated.
+ * @return number of written characters.
+ */
+int JsonWriter_formatInt(char* out, long long value);
+
+/* end of public interface */
+
+/* private part */
+
+struct _JsonWriter
+{
+	JsonBuffer* buffer_;
+	char containers_[MAX_DEPTH + 1];
+	char hasElements_[MAX_DEPTH + 1];
+	int depth_;
+	int afterKey_;
+	int isInvalid;
+};
+
+/* end of private part */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // JSON_WRITER_H_